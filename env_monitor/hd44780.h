@@ -5,6 +5,90 @@
 /* ioctl 명령 정의 */
 #define LCD_IOCTL_MAGIC 'L'
 
+/* 화면 크기 (DT의 display-width-chars / display-height-chars) */
+struct lcd_geometry {
+  int cols;
+  int rows;
+};
+
+/*
+ * 사용자 정의 문자: bitmap[i]의 하위 5비트가 i번째 행 (bit4 = 왼쪽).
+ * 돌려받은 slot(0~7)을 문자 코드로 write하면 표시됨 (NUL을 피하려면 slot + 8도 같은 글리프).
+ * 다른 글리프 요청으로 슬롯이 교체되면 그 슬롯을 쓰던 셀은 공백으로 지워짐
+ */
+struct lcd_glyph {
+  unsigned char bitmap[8];
+  int slot; /* 출력 */
+};
+
+/*
+ * LCD_IOCTL_BATCH: 구간마다 셀 위치 pos부터 data[0 ~ len-1]을 씀 (write와 같은 규칙).
+ * len은 셀 수 + 행 수('\n')까지, 넘으면 -EINVAL. 성공하면 프레임에 쓴 바이트 합을 반환
+ * (영역 끝을 넘은 부분은 빠지므로 len 합보다 작을 수 있음).
+ * 포인터는 32/64비트 공통 레이아웃을 위해 unsigned long long에 담음
+ */
+#define LCD_BATCH_MAX_SEGS  32
+
+struct lcd_seg {
+  unsigned int pos;
+  unsigned int len;
+  unsigned long long data; /* (unsigned long)버퍼 주소 */
+};
+
+struct lcd_batch {
+  unsigned int nsegs;
+  unsigned int pad;
+  unsigned long long segs; /* (unsigned long)struct lcd_seg 배열 주소 */
+};
+
+/*
+ * 마퀴: row 행에 text[0 ~ len-1](공백으로 채워 40자 링)을 period_ms마다 한 칸씩 흘림.
+ * 모든 행이 같은 주기/방향이면(2행 이하) 하드웨어 display shift로 주기마다 명령 1바이트만 전송
+ */
+#define LCD_MARQUEE_LEFT   0
+#define LCD_MARQUEE_RIGHT  1
+
+struct lcd_marquee {
+  int row;
+  int period_ms; /* 20 이상 */
+  int dir;       /* LCD_MARQUEE_LEFT / RIGHT */
+  int len;       /* 0 ~ 40 */
+  char text[40];
+};
+
+struct lcd_marquee_speed {
+  int row;
+  int period_ms;
+};
+
+/*
+ * 파일별 창: 이 파일은 row/col부터 width x height 영역에만 쓰고 파일 위치도 창 기준.
+ * 다른 파일의 창과 겹치면 -EBUSY, width = height = 0이면 창 해제 (화면 전체)
+ */
+struct lcd_window {
+  int row;
+  int col;
+  int width;
+  int height;
+};
+
+/*
+ * 레이아웃 템플릿: fmt를 한 번 등록하고 이후에는 필드 값만 넘김.
+ *   %[w].[p]f  w칸, 값은 10^p 배율 정수 (예: %5.2f에 2345 → "23.45")
+ *   %[w]d      w칸 정수,  %% → '%',  '\n' → 영역의 다음 행, 그 외는 그대로 표시
+ * 필드는 오른쪽 정렬, 넘치면 '#'. 위치는 창(없으면 화면) 기준
+ */
+#define LCD_LAYOUT_MAX_FIELDS  8
+
+struct lcd_layout {
+  char fmt[128]; /* NUL 종료 */
+};
+
+struct lcd_layout_values {
+  unsigned int nvals;                 /* 앞에서부터 갱신할 필드 수 */
+  int vals[LCD_LAYOUT_MAX_FIELDS];
+};
+
 enum lcd_ioctl_cmd {
   LCD_IOCTL_BACKLIGHT_ON = _IO(LCD_IOCTL_MAGIC, 0),
   LCD_IOCTL_BACKLIGHT_OFF = _IO(LCD_IOCTL_MAGIC, 1),
@@ -14,8 +98,30 @@ enum lcd_ioctl_cmd {
   LCD_IOCTL_HOME = _IO(LCD_IOCTL_MAGIC, 5),
   LCD_IOCTL_ENTRY_MODE = _IOW(LCD_IOCTL_MAGIC, 6, int),
   LCD_IOCTL_SET_CURSOR = _IOW(LCD_IOCTL_MAGIC, 7, int),
+  LCD_IOCTL_COMMIT = _IO(LCD_IOCTL_MAGIC, 8),              /* mmap 프레임버퍼 변경분 즉시 반영 */
+  LCD_IOCTL_SET_REFRESH = _IOW(LCD_IOCTL_MAGIC, 9, int),   /* mmap 스캔 주기(ms), 0 = COMMIT 때만 */
+  LCD_IOCTL_GET_GEOMETRY = _IOR(LCD_IOCTL_MAGIC, 10, struct lcd_geometry),
+  LCD_IOCTL_GLYPH = _IOWR(LCD_IOCTL_MAGIC, 11, struct lcd_glyph),  /* 5x8 비트맵 → CGRAM 슬롯 */
+  LCD_IOCTL_BATCH = _IOW(LCD_IOCTL_MAGIC, 12, struct lcd_batch),   /* 여러 구간을 한 프레임으로 */
+  LCD_IOCTL_SET_COMMIT_MODE = _IOW(LCD_IOCTL_MAGIC, 13, int),      /* LCD_COMMIT_* */
+  LCD_IOCTL_MARQUEE_START = _IOW(LCD_IOCTL_MAGIC, 14, struct lcd_marquee),
+  LCD_IOCTL_MARQUEE_STOP = _IOW(LCD_IOCTL_MAGIC, 15, int),         /* 행 번호, -1 = 모든 행 */
+  LCD_IOCTL_MARQUEE_SPEED = _IOW(LCD_IOCTL_MAGIC, 16, struct lcd_marquee_speed),
+  LCD_IOCTL_SET_WINDOW = _IOW(LCD_IOCTL_MAGIC, 17, struct lcd_window),
+  LCD_IOCTL_LAYOUT_SET = _IOW(LCD_IOCTL_MAGIC, 18, struct lcd_layout),
+  LCD_IOCTL_LAYOUT_UPDATE = _IOW(LCD_IOCTL_MAGIC, 19, struct lcd_layout_values),
 };
 
+/*
+ * Commit 모드 (LCD_IOCTL_SET_COMMIT_MODE)
+ * AUTO   : write/BATCH/mmap 변경이 바로 LCD로 (기본)
+ * MANUAL : 변경은 back buffer에만 쌓이고 LCD_IOCTL_COMMIT 때 변경분만 한 번의 버스트로 반영
+ * PACED  : MANUAL과 같되 commit은 다음 프레임 클럭(refresh_ms 주기)에 반영, 그 사이 commit은 합쳐짐
+ */
+#define LCD_COMMIT_AUTO    0
+#define LCD_COMMIT_MANUAL  1
+#define LCD_COMMIT_PACED   2
+
 /* Entry Mode flags (0x04 ~ 0x07) */
 #define LCD_ENTRY_LEFT        0x04
 #define LCD_ENTRY_LEFT_SHIFT  0x05
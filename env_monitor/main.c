@@ -7,96 +7,141 @@
 #include <signal.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <poll.h>
+#include <errno.h>
 #include "gpiosw.h"
 #include "hd44780.h"
+#include "scd41.h"
 
-#define SYSFS_PATH_CO2     "/sys/bus/i2c/devices/1-0062/co2"
-#define SYSFS_PATH_TEMP    "/sys/bus/i2c/devices/1-0062/temp"
-#define SYSFS_PATH_HUM     "/sys/bus/i2c/devices/1-0062/hum"
+#define SYSFS_PATH_MEAS    "/sys/bus/i2c/devices/1-0062/measurement_bin"
 #define SYSFS_PATH_ENABLE  "/sys/bus/i2c/devices/1-0062/enable"
+#define SYSFS_PATH_SEQ     "/sys/bus/i2c/devices/1-0062/seq"
 #define GPIO_SW_PATH       "/dev/gpiosw"
-#define HD44780_PATH       "/dev/hd44780"
+#define HD44780_PATH       "/dev/hd44780-0"
 
 void open_files();
 void close_files();
 void display_on();
 void display_clear();
 void set_cursor(int pos);
+void set_layout(const char* fmt);
+void update_values(int temp, int hum, int co2);
 void write_to_lcd(char* buf);
 void enable_scd41(bool on);
 
 bool measuring = false;
-int fd_co2, fd_temp, fd_hum, fd_sw, fd_lcd;
-char co2_str[32], temp_str[32], hum_str[32];
+int fd_meas, fd_seq, fd_sw, fd_lcd;
+int stop_pipe[2]; // 측정 중지 시 print_value 스레드를 깨움 (읽는 쪽 O_NONBLOCK)
+int sig_pipe[2]; // SIGUSR1 핸들러 → main 루프 (self-pipe, 쓰는 쪽 O_NONBLOCK)
+pthread_t printer; // 측정 중일 때만 살아 있음, 중지할 때 join
+struct scd41_measurement meas; // 한 측정의 값 (pread 한 번)
 void read_air_value();
+void read_seq();
+void drain_stop_pipe();
 
 bool running = false;
 
 void* print_value(void* arg) {
-  char buf[32];
   display_clear();
+  /* 템플릿은 한 번만 등록, 이후에는 값(0.01 단위 정수)만 넘김 */
+  set_layout("%5.2f\xDF" "C\n%5.2f%% / %4dppm");
   read_air_value();
-  sprintf(buf, "%s%cC\n%s%% / %sppm", temp_str, (char)0xDF, hum_str, co2_str);
-  write_to_lcd(buf);
-  usleep(1000000);
+  update_values(meas.temp_centi, meas.hum_centi, meas.co2);
+  read_seq(); // 읽어야 다음 sysfs_notify에 poll이 깨어남
   while (running) {
-    for (int i = 0; i < 50; ++i) {
-      usleep(100000);
-      if (!running) {
-        break;
+    /* 새 측정(seq 갱신) 또는 중지 요청이 올 때까지 잠듦 → 측정마다 한 번만 깨어남 */
+    struct pollfd fds[2] = {
+      { fd_seq, POLLPRI | POLLERR, 0 },
+      { stop_pipe[0], POLLIN, 0 },
+    };
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
       }
+      perror("poll");
+      break;
     }
-    if (!running) {
+    if (fds[1].revents & POLLIN) {
+      char c;
+      read(stop_pipe[0], &c, 1);
       break;
     }
+    if (!(fds[0].revents & (POLLPRI | POLLERR))) {
+      continue;
+    }
+    read_seq();
     read_air_value();
-    set_cursor(0); write_to_lcd(temp_str);
-    set_cursor(16); write_to_lcd(hum_str);
-    set_cursor(25); write_to_lcd(co2_str);
+    /* 세 값을 한 번의 ioctl로 → 한 프레임으로, 바뀐 자릿수만 전송 */
+    update_values(meas.temp_centi, meas.hum_centi, meas.co2);
   }
+  return NULL;
 }
 
+/* 시그널 핸들러는 self-pipe에 한 바이트만 씀, 시작/중지는 main에서 처리 */
 void sigusr1_handler(int signo) {
   if (signo == SIGUSR1) {
-    char buf[128];
-    if (!measuring) {
-      display_clear();
-      enable_scd41(true);
-      sprintf(buf, "MEASURING ... ");
-      write_to_lcd(buf);
-      for (int i = 5; i >= 1; --i) {
-        sprintf(buf, "%d", i);
-        write_to_lcd(buf);
-        sleep(1);
-        set_cursor(14);
-      }
-      measuring = true;
+    int saved = errno;
+    write(sig_pipe[1], "s", 1);
+    errno = saved;
+  }
+}
 
-      pthread_t t;
-      running = true;
-      pthread_create(&t, NULL, print_value, NULL);
-      pthread_detach(t);
-    }
-    else {
-      running = false;
-      enable_scd41(false);
-      display_clear();
-      sprintf(buf, "PRESS BUTTON TO\nSTART MEASURING");
-      write_to_lcd(buf);
-      measuring = false;
-    }
+void start_measuring() {
+  char buf[128];
+  sigset_t set, old;
 
-    signal(SIGUSR1, sigusr1_handler);
+  display_clear();
+  enable_scd41(true);
+  sprintf(buf, "MEASURING ... ");
+  write_to_lcd(buf);
+  for (int i = 5; i >= 1; --i) {
+    sprintf(buf, "%d", i);
+    write_to_lcd(buf);
+    sleep(1);
+    set_cursor(14);
   }
+  measuring = true;
+
+  drain_stop_pipe(); // 이전 스레드가 읽지 않고 끝났으면 남아 있는 바이트를 버림
+  running = true;
+  /* print_value 스레드는 SIGUSR1을 막은 채로 시작 → 시그널은 main 스레드만 받음 */
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &set, &old);
+  pthread_create(&printer, NULL, print_value, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+void stop_measuring() {
+  running = false;
+  write(stop_pipe[1], "x", 1); // print_value의 poll을 깨움
+  pthread_join(printer, NULL); // 스레드가 끝난 뒤에 화면을 바꾸고, 다음 시작과 겹치지 않게
+  enable_scd41(false);
+  display_clear();
+  write_to_lcd("PRESS BUTTON TO\nSTART MEASURING");
+  measuring = false;
 }
 
 int main() {
-  if (signal(SIGUSR1, sigusr1_handler) == SIG_ERR) {
-    perror("signal");
+  struct sigaction sa = { 0 };
+
+  pid_t pid = getpid();
+  if (pipe(stop_pipe) < 0 || fcntl(stop_pipe[0], F_SETFL, O_NONBLOCK) < 0) {
+    perror("pipe");
+    return 1;
+  }
+  if (pipe(sig_pipe) < 0 || fcntl(sig_pipe[1], F_SETFL, O_NONBLOCK) < 0) {
+    perror("pipe");
+    return 1;
+  }
+
+  sa.sa_handler = sigusr1_handler;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGUSR1, &sa, NULL) < 0) {
+    perror("sigaction");
     return 1;
   }
 
-  pid_t pid = getpid();
   open_files();
 
   if (ioctl(fd_sw, GPIO_IOCTL_REGISTER_PID, pid) < 0) {
@@ -109,7 +154,21 @@ int main() {
   write_to_lcd("PRESS BUTTON TO\nSTART MEASURING");
 
   while (1) {
-    pause();
+    char c;
+    ssize_t n = read(sig_pipe[0], &c, 1); // 버튼(SIGUSR1)이 눌릴 때까지 잠듦
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      perror("read sig_pipe");
+      break;
+    }
+    if (!measuring) {
+      start_measuring();
+    }
+    else {
+      stop_measuring();
+    }
   }
 
   close_files();
@@ -131,29 +190,27 @@ void enable_scd41(bool on) {
   close(fd_enable);
 }
 
-void read_air_value() {
-  int len;
-  lseek(fd_temp, 0, SEEK_SET);
-  if ((len = read(fd_temp, temp_str, sizeof(temp_str) - 1)) < 0) {
-    perror("read temp");
-    close_files();
-    exit(1);
-  }
-  temp_str[len - 1] = '\0';
-  lseek(fd_hum, 0, SEEK_SET);
-  if ((len = read(fd_hum, hum_str, sizeof(hum_str) - 1)) < 0) {
-    perror("read hum");
+void drain_stop_pipe() {
+  char c;
+  while (read(stop_pipe[0], &c, 1) > 0);
+}
+
+void read_seq() {
+  char buf[32];
+  if (pread(fd_seq, buf, sizeof(buf), 0) < 0) {
+    perror("read seq");
     close_files();
     exit(1);
   }
-  hum_str[len - 1] = '\0';
-  lseek(fd_co2, 0, SEEK_SET);
-  if ((len = read(fd_co2, co2_str, sizeof(co2_str) - 1)) < 0) {
-    perror("read co2");
+}
+
+/* 세 값이 항상 같은 측정에서 나오도록 바이너리 스냅샷을 한 번에 읽음 */
+void read_air_value() {
+  if (pread(fd_meas, &meas, sizeof(meas), 0) != sizeof(meas)) {
+    perror("read measurement");
     close_files();
     exit(1);
   }
-  co2_str[len - 1] = '\0';
 }
 
 void write_to_lcd(char* buf) {
@@ -198,42 +255,52 @@ void set_cursor(int pos) {
   }
 }
 
-void open_files() {
-  fd_co2 = open(SYSFS_PATH_CO2, O_RDONLY);
-  if (fd_co2 < 0) {
-    perror("open co2");
+void set_layout(const char* fmt) {
+  struct lcd_layout layout;
+  snprintf(layout.fmt, sizeof(layout.fmt), "%s", fmt);
+  if (ioctl(fd_lcd, LCD_IOCTL_LAYOUT_SET, &layout) < 0) {
+    perror("ioctl LCD_IOCTL_LAYOUT_SET");
+    close_files();
     exit(1);
   }
-  fd_temp = open(SYSFS_PATH_TEMP, O_RDONLY);
-  if (fd_temp < 0) {
-    perror("open temp");
-    close(fd_co2);
+}
+
+void update_values(int temp, int hum, int co2) {
+  struct lcd_layout_values vals = { 3, { temp, hum, co2 } };
+  if (ioctl(fd_lcd, LCD_IOCTL_LAYOUT_UPDATE, &vals) < 0) {
+    perror("ioctl LCD_IOCTL_LAYOUT_UPDATE");
+  }
+}
+
+void open_files() {
+  fd_meas = open(SYSFS_PATH_MEAS, O_RDONLY);
+  if (fd_meas < 0) {
+    perror("open measurement_bin");
     exit(1);
   }
-  fd_hum = open(SYSFS_PATH_HUM, O_RDONLY);
-  if (fd_hum < 0) {
-    perror("open hum");
-    close(fd_co2); close(fd_temp);
+  fd_seq = open(SYSFS_PATH_SEQ, O_RDONLY);
+  if (fd_seq < 0) {
+    perror("open seq");
+    close(fd_meas);
     exit(1);
   }
   fd_sw = open(GPIO_SW_PATH, O_RDONLY);
   if (fd_sw < 0) {
     perror("open gpiosw");
-    close(fd_co2); close(fd_temp); close(fd_hum);
+    close(fd_meas); close(fd_seq);
     exit(1);
   }
   fd_lcd = open(HD44780_PATH, O_WRONLY);
   if (fd_lcd < 0) {
     perror("open hd44780");
-    close(fd_co2); close(fd_temp); close(fd_hum); close(fd_sw);
+    close(fd_meas); close(fd_seq); close(fd_sw);
     exit(1);
   }
 }
 
 void close_files() {
-  close(fd_co2);
-  close(fd_temp);
-  close(fd_hum);
+  close(fd_meas);
+  close(fd_seq);
   close(fd_sw);
   close(fd_lcd);
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef __SCD41_H_
+#define __SCD41_H_
+
+#include <linux/ioctl.h>
+
+/*
+ * /dev/scd41-N 에서 read()로 받는 측정 레코드 (고정 크기, 24바이트).
+ * read 크기는 레코드 크기의 배수여야 하고, 쌓여 있는 레코드를 한 번에 여러 개 받을 수 있음
+ */
+struct scd41_sample {
+  unsigned long long timestamp_ns; /* 측정이 만들어진 시각 (CLOCK_REALTIME) */
+  int co2;                         /* ppm */
+  int temp_centi;                  /* 0.01 °C */
+  int hum_centi;                   /* 0.01 %RH */
+  unsigned int status;             /* SCD41_STATUS_* */
+};
+
+/* status 비트 */
+#define SCD41_STATUS_OVERRUN  0x01 /* 버퍼가 가득 차 이 레코드 앞의 오래된 레코드가 버려짐 */
+#define SCD41_STATUS_FIRST    0x02 /* enable 또는 모드 전환 후 첫 측정 */
+#define SCD41_STATUS_RHT_ONLY 0x04 /* 온습도만 측정 (co2는 이전 값) */
+
+/*
+ * 이동 통계 (sysfs stats_windows로 창 길이 설정, 기본 1분 / 15분 / 1시간).
+ * 값의 단위는 측정과 같음 (co2 ppm, temp/hum 0.01). count = 0이면 창이 꺼져 있거나 아직 측정 없음
+ */
+#define SCD41_STATS_WINDOWS  3
+
+/* scd41_window_stats.flags */
+#define SCD41_STATS_TRUNCATED 0x01 /* 창 안에 들어갈 측정 일부가 보관 한도(최근 720개)를 넘어 빠짐 */
+
+struct scd41_stat {
+  int min;
+  int max;
+  int mean;
+  int median;
+  int ema;    /* 시정수 = 창 길이 */
+};
+
+struct scd41_window_stats {
+  unsigned int window_s;  /* 창 길이 (초), 0 = 사용 안 함 */
+  unsigned int count;     /* 창 안의 측정 수 */
+  unsigned int span_s;    /* 창 안의 가장 오래된 측정부터 마지막 측정까지 (초), 실제로 덮은 구간 */
+  unsigned int flags;     /* SCD41_STATS_* */
+  struct scd41_stat co2;
+  struct scd41_stat temp;
+  struct scd41_stat hum;
+};
+
+/*
+ * sysfs measurement_bin: 마지막 측정 하나와 그 측정까지의 이동 통계 (264바이트),
+ * pread(fd, &m, sizeof(m), 0) 한 번으로 같은 측정의 값만 읽힘 (seq = 0이면 아직 측정 없음).
+ * 앞 32바이트는 이전 레이아웃과 같음
+ */
+struct scd41_measurement {
+  unsigned long long timestamp_ns; /* CLOCK_REALTIME */
+  unsigned long long seq;          /* 새 측정마다 1 증가 */
+  int co2;                         /* ppm */
+  int temp_centi;                  /* 0.01 °C */
+  int hum_centi;                   /* 0.01 %RH */
+  unsigned int pad;
+  struct scd41_window_stats stats[SCD41_STATS_WINDOWS];
+};
+
+/*
+ * 측정 모드 (sysfs mode, SCD41_IOCTL_SET_MODE). 측정 중에 바꾸면 센서를 멈추고 새 모드로 다시 시작.
+ * SINGLE_SHOT*은 센서를 쉬게 두고 SCD41_IOCTL_MEASURE 요청마다 한 번만 측정 (enable = 1 필요)
+ */
+#define SCD41_MODE_PERIODIC         0 /* 5초 주기 (기본) */
+#define SCD41_MODE_LOW_POWER        1 /* 30초 주기 */
+#define SCD41_MODE_SINGLE_SHOT      2 /* 요청마다 한 번, 약 5초 뒤 결과 */
+#define SCD41_MODE_SINGLE_SHOT_RHT  3 /* 요청마다 온습도만, 약 50ms 뒤 결과 */
+#define SCD41_MODE_AUTO             4 /* 값이 안정되면 LOW_POWER, 변하기 시작하면 PERIODIC */
+
+/* ioctl 명령 정의 (/dev/scd41-N) */
+#define SCD41_IOCTL_MAGIC 'S'
+
+enum scd41_ioctl_cmd {
+  SCD41_IOCTL_SET_MODE = _IOW(SCD41_IOCTL_MAGIC, 0, int),
+  SCD41_IOCTL_GET_MODE = _IOR(SCD41_IOCTL_MAGIC, 1, int),
+  SCD41_IOCTL_MEASURE = _IO(SCD41_IOCTL_MAGIC, 2), /* 단발 측정 요청, 결과는 read()/poll()로 */
+};
+
+#endif
@@ -1,10 +1,29 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/ctype.h>
 #include <linux/fs.h>
+#include <linux/cdev.h>
 #include <linux/device.h>
 #include <linux/uaccess.h>
 #include <linux/i2c.h>
 #include <linux/delay.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/property.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/kthread.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/mm.h>
+#include <linux/idr.h>
+#include <linux/jhash.h>
+#include <linux/uio.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+#include <linux/bitmap.h>
+#include <linux/kref.h>
 #include "hd44780.h"
 
 MODULE_LICENSE("GPL");
@@ -13,223 +32,2290 @@ MODULE_DESCRIPTION("I2C LCD Character Device Driver (write=print, ioctl=control)
 
 #define CLASS_NAME  "hd44780_class"
 #define DEVICE_NAME "hd44780"
-#define NODE_NAME   "hd44780"
+#define NODE_NAME   "hd44780-%d"  /* /dev/hd44780-0, /dev/hd44780-1, ... */
 
-static int device_major;
-static int device_minor = 0;
+#define LCD_MAX_DEVICES 8
+#define LCD_MAX_ROWS    4
+#define LCD_MAX_CELLS   80   /* HD44780 DDRAM 크기 */
+#define LCD_DDRAM_SIZE  0x80 /* 2-line 모드: 0x00~0x27, 0x40~0x67 */
+#define LCD_LINE_LEN    0x28 /* DDRAM 한 줄 길이 (40자) */
+#define LCD_AC_UNKNOWN  0xFF /* AC 위치를 알 수 없음 → 다음 쓰기 전에 주소 설정 */
+
+/* === 저수준 LCD 제어 함수 === */
+/* PCF8574 핀 배치 (help.txt 참고), lcd_send()의 mode(LCD_RS/LCD_RW)도 같은 값을 씀 */
+#define LCD_RS  0x01
+#define LCD_RW  0x02
+#define LCD_EN  0x04
+#define LCD_BL  0x08
+
+struct hd44780;
+
+/*
+ * I/O 확장기 백엔드 (DT compatible로 선택).
+ * 전송 버퍼에는 확장기 포트에 순서대로 쓸 바이트를 쌓고, reg가 있으면 버퍼 맨 앞에 둠.
+ * - PCF8574 : 레지스터 없음, 4비트 모드 (P4~P7 = D4~D7)
+ * - MCP23008: OLAT 한 레지스터에 연속 쓰기 (IOCON.SEQOP=1), 4비트 모드 (GP3~GP6 = D4~D7)
+ * - MCP23017: IOCON.BANK=0, SEQOP=1이면 주소가 OLATA/OLATB를 번갈아 가리킴
+ *             → A(D0~D7), B(RS/RW/EN/BL) 쌍을 이어 쓰는 8비트 모드
+ */
+struct lcd_backend {
+  const char* name;
+  bool has_reg;
+  u8 reg;          /* 연속 쓰기를 시작할 레지스터 */
+  bool eight_bit;
+  bool busy_flag;  /* BF 읽기 지원 (PCF8574만) */
+  u8 rs, rw, en, bl;
+  u8 d4_shift;     /* 4비트 모드: 포트에서 D4의 비트 위치 */
+  int (*setup)(struct hd44780* lcd);
+};
+
+/*
+ * === 타이밍 ===
+ * 고정 mdelay 대신 "컨트롤러가 다음 명령을 받을 수 있는 시각"을 기록해 두고,
+ * 다음 전송 직전에 남은 시간만큼만 기다린다. 긴 대기는 usleep_range(hrtimer)로 잠든다.
+ */
+struct lcd_timing {
+  u32 exec_us;  /* 데이터 쓰기 및 대부분의 명령 (fosc=270kHz 기준 37us) */
+  u32 clear_us; /* Clear Display / Return Home (1.52ms) */
+};
+
+/* 데이터시트 기본값, DT의 hitachi,exec-time-us / hitachi,clear-time-us로 재정의 */
+static const struct lcd_timing lcd_default_timing = {
+    .exec_us = 37,
+    .clear_us = 1520,
+};
+
+#define LCD_SLEEP_MIN_US   10 /* 이보다 짧은 대기만 udelay로 처리 */
+#define LCD_STREAM_GAP_US  45 /* 400kHz에서도 EN 하강 사이에 2바이트(45us)가 버스에 나감 */
+
+/* 명령 종류별 통계 (debugfs busy_stats) */
+enum lcd_op {
+  LCD_OP_DATA,
+  LCD_OP_CMD,
+  LCD_OP_CLEAR, /* Clear Display / Return Home */
+  LCD_OP_NR,
+  LCD_OP_NONE = LCD_OP_NR,
+};
+
+static const char* const lcd_op_names[LCD_OP_NR] = { "data", "cmd", "clear" };
+
+struct lcd_op_stats {
+  u64 ops;       /* 전송한 명령 수 */
+  u64 waits;     /* 전송 경계에서 완료를 기다린 횟수 */
+  u64 polls;     /* BF 읽기 횟수 */
+  u32 max_polls; /* 한 번 기다릴 때 최대 BF 읽기 횟수 */
+  u64 wait_ns;   /* 기다린 총 시간 (폴링 또는 sleep) */
+};
+
+/*
+ * PCF8574는 한 트랜잭션 안에서 받은 바이트를 순서대로 출력 핀에 반영하므로
+ * data / EN=1 / EN=0 시퀀스를 버퍼에 모아 한 번에 전송한다.
+ * 한 번에 보내는 크기를 제한해 i2c1을 공유하는 SCD41이 사이에 끼어들 수 있게 함
+ * (SMBus I2C block write의 최대 길이 32바이트와 맞춤).
+ */
+#define LCD_XFER_MAX  32
+
+/*
+ * COMMIT 한 번의 변경분은 LCD_XFER_MAX 단위 메시지 여러 개를 i2c_transfer 한 번
+ * (repeated START, 버스 점유)으로 보냄 → 다른 장치가 중간에 끼어들 수 없는 한 덩어리.
+ * 주소 설정 + 데이터 셀당 최대 10바이트, 80셀이면 800바이트
+ */
+#define LCD_BURST_MAX   1024
+#define LCD_BURST_MSGS  (LCD_BURST_MAX / LCD_XFER_MAX)
+
+enum lcd_xfer_mode {
+  LCD_XFER_I2C,         /* i2c_master_send 한 번에 여러 바이트 */
+  LCD_XFER_SMBUS_BLOCK, /* 첫 바이트를 command로 쓰는 SMBus I2C block write */
+  LCD_XFER_SMBUS_BYTE,  /* 어댑터가 바이트 단위 쓰기만 지원 */
+};
+
+/*
+ * CGRAM 글리프 캐시: 사용자는 5x8 비트맵을 내용으로 요청하고 드라이버가 슬롯(0~7)을 고름.
+ * 같은 비트맵이면 CGRAM을 다시 쓰지 않고 기존 슬롯을 돌려주므로
+ * 애니메이션 막대 그래프도 프레임마다 바뀐 셀 몇 바이트만 전송됨.
+ */
+#define LCD_GLYPH_SLOTS  8
+#define LCD_GLYPH_ROWS   8
+
+struct lcd_glyph_slot {
+  bool valid;
+  u32 hash;
+  u8 bitmap[LCD_GLYPH_ROWS];
+  u64 last_used; /* LRU용, glyph_clock 값 */
+};
+
+/*
+ * 마퀴(행 단위 흐르는 글자): 행마다 40자 링을 두고 주기마다 한 칸씩 돌림.
+ * Cursor/Display Shift(0x18/0x1C)는 모든 행을 함께 밀기 때문에
+ * 화면의 모든 행이 같은 주기/방향으로 흐를 때만(2행 이하) 하드웨어 shift를 쓰고
+ * (링 40자를 DDRAM에 한 번 올린 뒤 주기마다 명령 1바이트),
+ * 나머지 경우는 해당 행의 셀만 다시 씀 (셀 비교로 바뀐 글자만 전송)
+ */
+#define LCD_MARQUEE_MIN_MS  20
+
+struct lcd_marquee_row {
+  bool active;
+  u8 text[LCD_LINE_LEN]; /* 공백으로 채운 40자 링 */
+  u32 period_ms;
+  int dir;               /* LCD_MARQUEE_LEFT / RIGHT */
+  int offset;            /* 행 첫 칸에 보이는 링 위치 */
+  ktime_t next;          /* 다음 이동 시각 */
+};
+
+/*
+ * mmap 프레임버퍼: 셀 위치(0 ~ cells-1) 순서의 문자 한 페이지.
+ * 사용자는 시스템 콜 없이 바이트만 쓰고, refresh work가 주기적으로(또는 COMMIT ioctl 시)
+ * 지난번 스캔과 달라진 셀만 프레임에 옮겨 flush worker에 넘긴다.
+ */
+static unsigned int refresh_ms = 100;
+module_param(refresh_ms, uint, 0644);
+MODULE_PARM_DESC(refresh_ms, "default mmap framebuffer scan period in ms (0 = only on LCD_IOCTL_COMMIT)");
+
+/* 화면의 직사각형 영역 (셀 단위) */
+struct lcd_region {
+  int row;
+  int col;
+  int width;
+  int height;
+};
+
+/*
+ * LCD 한 대의 상태. 버스/주소가 다른 LCD는 락과 worker가 따로라 병렬로 갱신됨.
+ * 열린 파일과 mmap이 참조를 잡고 있으므로 unbind 후에도 마지막 참조가 풀릴 때까지 남음
+ * (removed 이후 파일 연산은 -ENODEV, I2C는 건드리지 않음)
+ */
+struct hd44780 {
+  struct i2c_client* client;
+  struct device* dev;  /* /dev/hd44780-N */
+  struct cdev* cdev;   /* 열린 파일이 참조하므로 lcd와 따로 해제됨 (cdev_alloc) */
+  struct kref kref;
+  bool removed;        /* lock 아래에서 설정 */
+  int id;
+  int backlight;
+
+  /* 화면 구성 (DT: display-width-chars / display-height-chars) */
+  int cols;
+  int rows;
+  int cells;
+  u8 row_offsets[LCD_MAX_ROWS];
+
+  struct lcd_timing timing;
+
+  /* DDRAM 섀도우: LCD에 실제로 써진 내용을 DDRAM 주소 기준으로 보관 (lock) */
+  struct mutex lock; /* I2C 전송과 섀도우 보호, 전송 동안 잡고 있음 */
+  u8 ddram[LCD_DDRAM_SIZE];
+  DECLARE_BITMAP(ddram_stale, LCD_DDRAM_SIZE); /* 전송 실패로 LCD 내용을 알 수 없는 셀 */
+  u8 ac;             /* 하드웨어 Address Counter */
+  u8 entry;          /* 현재 Entry Mode */
+
+  /* 전송 버퍼 (lock) */
+  const struct lcd_backend* be;
+  enum lcd_xfer_mode xfer_mode;
+  u8 xbuf[LCD_XFER_MAX];
+  int xhdr;              /* 버퍼 앞의 레지스터 주소 바이트 수 (0 또는 1) */
+  int xlen;
+  u8 xctrl;              /* 버퍼 끝 기준 RS/RW 상태 */
+  u8 xlast;              /* 마지막으로 버스에 나간 바이트 */
+  u32 xexec_us;          /* 버퍼에 쌓인 마지막 명령/데이터의 실행 시간 */
+  enum lcd_op xop;       /* 버퍼에 쌓인 마지막 명령 종류 */
+  enum lcd_op pending_op; /* 전송됐지만 완료를 기다리지 않은 명령 */
+  ktime_t ready_at;      /* 컨트롤러가 다음 명령을 받을 수 있는 시각 */
+
+  /* 버스트 전송 (lock) */
+  bool burst;            /* lcd_xfer_send가 보내지 않고 burst_msgs에 모음 */
+  u8 burst_buf[LCD_BURST_MAX];
+  int burst_len;
+  struct i2c_msg burst_msgs[LCD_BURST_MSGS];
+  int burst_nmsgs;
+
+  /* Busy Flag 폴링 (lock) */
+  bool busy_flag;
+  u32 busy_timeouts;
+  struct lcd_op_stats stats[LCD_OP_NR];
+  struct dentry* debugfs;
+
+  /* CGRAM 글리프 캐시 (lock) */
+  struct lcd_glyph_slot glyphs[LCD_GLYPH_SLOTS];
+  u64 glyph_clock;
+  u64 glyph_hits;
+  u64 glyph_uploads;
+  u64 glyph_evictions; /* 화면에 보이던 글리프를 교체한 횟수 */
+
+  /*
+   * 프레임: write()가 채우는 "보여야 할" 내용 (frame_lock).
+   * 전송은 flush worker가 프레임과 섀도우를 비교해 바뀐 셀만 처리하므로
+   * 같은 셀에 대한 새 write는 아직 나가지 않은 이전 내용을 덮어씀 → 밀린 작업이 쌓이지 않음.
+   */
+  spinlock_t frame_lock;
+  u8 frame[LCD_DDRAM_SIZE];
+  u64 write_seq;   /* write마다 증가 */
+  u64 flushed_seq; /* LCD에 반영이 끝난 write_seq */
+
+  /*
+   * 수동 commit 모드: frame은 사용자가 채우는 back buffer가 되고, COMMIT 시점의 frame을
+   * committed에 복사해 그것만 LCD(front = ddram 섀도우)로 보냄
+   */
+  int commit_mode;          /* LCD_COMMIT_AUTO / MANUAL / PACED */
+  u8 committed[LCD_DDRAM_SIZE];
+  u64 commit_seq;           /* committed에 담긴 write_seq */
+  int flush_err;   /* 비동기 전송 에러, fsync에서 보고 */
+  wait_queue_head_t flush_wq;
+
+  struct kthread_worker* worker;
+  struct kthread_work flush_work;
+
+  /* mmap 프레임버퍼 */
+  u8* mmap_buf;                   /* 사용자에게 매핑되는 페이지 */
+  u8 mmap_snap[LCD_MAX_CELLS];    /* 마지막 스캔 시점의 내용 (frame_lock) */
+  atomic_t mmap_users;
+  unsigned int refresh_ms;
+  struct kthread_delayed_work refresh_work;
+
+  /* 파일별 창 목록 (lock) */
+  struct list_head windows;
+
+  /* 마퀴 (lock), 타이머는 worker에 작업만 넘김 */
+  struct lcd_marquee_row marquee[LCD_MAX_ROWS];
+  bool marquee_hw;       /* 하드웨어 display shift 사용 중 */
+  struct hrtimer marquee_timer;
+  struct kthread_work marquee_work;
+};
+
+/* 레이아웃 필드: 영역 안 위치 pos부터 width칸, 값은 10^prec 배율 고정소수점 */
+struct lcd_layout_field {
+  u8 pos;
+  u8 width;
+  u8 prec;
+  bool fixed; /* %f */
+};
+
+/*
+ * 열린 파일마다의 상태. 창을 잡은 파일은 그 영역 안에서만 쓰고,
+ * 파일 위치도 창 기준 셀 위치. 창이 없으면 화면 전체가 영역
+ */
+struct lcd_file {
+  struct hd44780* lcd;
+  struct lcd_region win; /* frame_lock (바꿀 때는 lock도) */
+  bool windowed;
+  struct list_head node; /* lcd->windows */
+
+  /* 레이아웃 템플릿 (frame_lock) */
+  struct lcd_layout_field fields[LCD_LAYOUT_MAX_FIELDS];
+  int nfields;
+};
+
+static dev_t lcd_devt;
 static struct class* lcd_class;
-static struct device* lcd_device;
-static struct i2c_client* lcd_client;
-static int backlight = 0;
+static struct dentry* lcd_debugfs_root;
+static DEFINE_IDA(lcd_ida);
+
+/* minor → LCD, open이 참조를 얻는 곳 (remove에서 비움) */
+static struct hd44780* lcd_table[LCD_MAX_DEVICES];
+static DEFINE_MUTEX(lcd_table_lock);
+
+/* devnode → /dev/hd44780-N 자동 생성, 권한 0666 */
+static char* lcd_devnode(const struct device* dev, umode_t* mode) {
+  if (mode)
+    *mode = 0666;
+  return NULL;
+}
+
+static void lcd_delay_us(u32 us) {
+  if (us < LCD_SLEEP_MIN_US)
+    udelay(us);
+  else
+    usleep_range(us, us + us / 8 + LCD_SLEEP_MIN_US);
+}
+
+static enum lcd_op lcd_op_type(uint8_t value, uint8_t mode) {
+  if (mode & LCD_RS)
+    return LCD_OP_DATA;
+  if (value == 0x01 || (value & 0xFE) == 0x02)
+    return LCD_OP_CLEAR;
+  return LCD_OP_CMD;
+}
+
+static u32 lcd_exec_time(struct hd44780* lcd, enum lcd_op op) {
+  return op == LCD_OP_CLEAR ? lcd->timing.clear_us : lcd->timing.exec_us;
+}
+
+/*
+ * === Busy Flag 폴링 (DT: hitachi,busy-flag) ===
+ * RW가 LCD에 연결된 모듈에서는 고정 실행 시간 대신 RW=1로 BF(D7)를 읽어
+ * 컨트롤러가 실제로 끝날 때까지만 기다린다. RW가 GND에 묶인 모듈은 고정 대기 사용.
+ */
+#define LCD_BUSY_MAX_POLLS  64
+
+/* BF 한 번 읽기: 1=busy, 0=ready, 음수=에러 */
+static int lcd_read_busy(struct hd44780* lcd) {
+  u8 bl = lcd->backlight ? LCD_BL : 0x00;
+  u8 rd = 0xF0 | LCD_RW | bl; /* D4~D7을 1로 써야 PCF8574 핀이 입력으로 동작 */
+  u8 seq1[2] = { rd, rd | LCD_EN };
+  u8 seq2[4] = { rd, rd | LCD_EN, rd, lcd->xlast };
+  u8 val;
+  int ret;
+
+  /* 상위 니블: RW setup 후 EN=1 동안 D7=BF */
+  ret = i2c_master_send(lcd->client, seq1, sizeof(seq1));
+  if (ret < 0)
+    return ret;
+  ret = i2c_master_recv(lcd->client, &val, 1);
+  if (ret < 0)
+    return ret;
+
+  /* EN=0, 하위 니블(AC 하위 비트)은 버리고, 마지막 출력 상태로 복구 */
+  ret = i2c_master_send(lcd->client, seq2, sizeof(seq2));
+  if (ret < 0)
+    return ret;
+
+  return (val & 0x80) ? 1 : 0;
+}
+
+/*
+ * 직전 명령의 완료를 기다림. 예상 완료 시각(ready_at)이 이미 지났으면 바로 반환하고,
+ * BF 폴링은 아직 실행 중일 수 있는 동안만 (BF 읽기 한 번이 I2C 세 번, 100kHz에서 약 1ms)
+ */
+static void lcd_wait_ready(struct hd44780* lcd) {
+  enum lcd_op op = lcd->pending_op;
+  ktime_t start = ktime_get();
+  s64 us = ktime_us_delta(lcd->ready_at, start);
+  int polls = 0;
+  int ret = 0;
+
+  if (op == LCD_OP_NONE)
+    return;
+  lcd->pending_op = LCD_OP_NONE;
+  if (us <= 0)
+    return;
+
+  if (lcd->busy_flag) {
+    do {
+      ret = lcd_read_busy(lcd);
+      polls++;
+    } while (ret > 0 && polls < LCD_BUSY_MAX_POLLS);
+
+    if (ret != 0) {
+      /* 읽기 실패 또는 시간 초과 → 남은 고정 대기로 대체 */
+      lcd->busy_timeouts++;
+      us = ktime_us_delta(lcd->ready_at, ktime_get());
+      if (us > 0)
+        lcd_delay_us(us);
+    }
+  }
+  else {
+    lcd_delay_us(us);
+  }
+
+  lcd->stats[op].waits++;
+  lcd->stats[op].polls += polls;
+  lcd->stats[op].max_polls = max_t(u32, lcd->stats[op].max_polls, polls);
+  lcd->stats[op].wait_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int lcd_busy_stats_show(struct seq_file* m, void* v) {
+  struct hd44780* lcd = m->private;
+  int op;
+
+  mutex_lock(&lcd->lock);
+  seq_printf(m, "backend: %s (%d-bit)\n", lcd->be->name, lcd->be->eight_bit ? 8 : 4);
+  seq_printf(m, "mode: %s\n", lcd->busy_flag ? "busy-flag" : "fixed-delay");
+  seq_printf(m, "timeouts: %u\n", lcd->busy_timeouts);
+  seq_printf(m, "%-6s %10s %10s %10s %9s %12s\n", "op", "ops", "waits", "polls", "max_polls", "wait_us");
+  for (op = 0; op < LCD_OP_NR; op++) {
+    struct lcd_op_stats* st = &lcd->stats[op];
+    seq_printf(m, "%-6s %10llu %10llu %10llu %9u %12llu\n", lcd_op_names[op],
+      st->ops, st->waits, st->polls, st->max_polls, div_u64(st->wait_ns, NSEC_PER_USEC));
+  }
+  mutex_unlock(&lcd->lock);
+
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lcd_busy_stats);
+
+/*
+ * 모아 둔 메시지를 i2c_transfer 한 번으로 전송.
+ * 버스트 안의 명령은 셀 주소 설정/데이터뿐이고 실행 시간(37us)은 EN 하강 사이의
+ * 버스 시간이 보장하므로(lcd_send 참고) 중간 대기 없이 이어서 보낼 수 있음.
+ * 버스트 이전 명령의 완료 대기는 버스트를 시작하기 전에 호출자가 처리
+ */
+static int lcd_burst_send(struct hd44780* lcd) {
+  int ret = 0;
+
+  if (lcd->burst_nmsgs) {
+    ret = i2c_transfer(lcd->client->adapter, lcd->burst_msgs, lcd->burst_nmsgs);
+    if (ret >= 0 && ret != lcd->burst_nmsgs)
+      ret = -EIO;
+  }
+  lcd->burst_len = 0;
+  lcd->burst_nmsgs = 0;
+
+  /* 마지막 명령의 완료 시각은 실제로 버스에 나간 시점 기준 */
+  if (lcd->pending_op != LCD_OP_NONE)
+    lcd->ready_at = ktime_add_us(ktime_get(), lcd_exec_time(lcd, lcd->pending_op));
+
+  return ret < 0 ? ret : 0;
+}
+
+/* 평문 I2C이고 실행 시간이 버스 시간 안에 끝나는 패널만 */
+static bool lcd_burst_ok(struct hd44780* lcd) {
+  return lcd->xfer_mode == LCD_XFER_I2C && lcd->timing.exec_us <= LCD_STREAM_GAP_US;
+}
+
+/* op_done: 버퍼가 명령 경계에서 끝남 (중간에 잘린 청크면 완료 대기/BF 폴링 금지) */
+static int lcd_xfer_send(struct hd44780* lcd, bool op_done) {
+  int ret = 0;
+  int i;
+
+  if (lcd->xlen == lcd->xhdr)
+    return 0;
+
+  if (lcd->burst) {
+    /* 버스트 버퍼가 차면 모은 만큼 먼저 보냄 (변경이 아주 많을 때만) */
+    if (lcd->burst_len + lcd->xlen > LCD_BURST_MAX || lcd->burst_nmsgs == LCD_BURST_MSGS)
+      ret = lcd_burst_send(lcd);
+    lcd->burst_msgs[lcd->burst_nmsgs++] = (struct i2c_msg) {
+      .addr = lcd->client->addr,
+      .flags = 0,
+      .len = lcd->xlen,
+      .buf = lcd->burst_buf + lcd->burst_len,
+    };
+    memcpy(lcd->burst_buf + lcd->burst_len, lcd->xbuf, lcd->xlen);
+    lcd->burst_len += lcd->xlen;
+    goto done;
+  }
+
+  lcd_wait_ready(lcd);
+
+  switch (lcd->xfer_mode) {
+  case LCD_XFER_I2C:
+    ret = i2c_master_send(lcd->client, lcd->xbuf, lcd->xlen);
+    if (ret >= 0 && ret != lcd->xlen)
+      ret = -EIO;
+    break;
+
+  case LCD_XFER_SMBUS_BLOCK:
+    if (lcd->xlen == 1)
+      ret = i2c_smbus_write_byte(lcd->client, lcd->xbuf[0]);
+    else
+      ret = i2c_smbus_write_i2c_block_data(lcd->client, lcd->xbuf[0], lcd->xlen - 1, lcd->xbuf + 1);
+    break;
+
+  case LCD_XFER_SMBUS_BYTE:
+    for (i = 0; i < lcd->xlen && ret >= 0; i++)
+      ret = i2c_smbus_write_byte(lcd->client, lcd->xbuf[i]);
+    break;
+  }
+
+done:
+  lcd->xlast = lcd->xbuf[lcd->xlen - 1];
+  lcd->xlen = lcd->xhdr;
+  if (op_done && lcd->xop != LCD_OP_NONE) {
+    lcd->ready_at = ktime_add_us(ktime_get(), lcd->xexec_us);
+    lcd->pending_op = lcd->xop;
+    lcd->xop = LCD_OP_NONE;
+    lcd->xexec_us = 0;
+  }
+  return ret < 0 ? ret : 0;
+}
+
+static int lcd_xfer_flush(struct hd44780* lcd) {
+  return lcd_xfer_send(lcd, true);
+}
+
+static u8 lcd_bl(struct hd44780* lcd) {
+  return lcd->backlight ? lcd->be->bl : 0x00;
+}
+
+/* 포트 바이트 하나 (PCF8574, MCP23008) */
+static void lcd_xfer_queue(struct hd44780* lcd, u8 port) {
+  if (lcd->xlen == LCD_XFER_MAX)
+    lcd_xfer_send(lcd, false);
+  lcd->xbuf[lcd->xlen++] = port | lcd_bl(lcd);
+}
+
+/* A/B 포트 쌍 (MCP23017), 쌍이 두 전송으로 나뉘면 A/B 순서가 어긋나므로 함께 넣음 */
+static void lcd_xfer_queue_ab(struct hd44780* lcd, u8 data, u8 ctrl) {
+  if (lcd->xlen + 2 > LCD_XFER_MAX)
+    lcd_xfer_send(lcd, false);
+  lcd->xbuf[lcd->xlen++] = data;
+  lcd->xbuf[lcd->xlen++] = ctrl | lcd_bl(lcd);
+}
+
+/* 논리 RS/RW → 백엔드 제어 핀 */
+static u8 lcd_ctrl_pins(struct hd44780* lcd, u8 mode) {
+  return ((mode & LCD_RS) ? lcd->be->rs : 0) | ((mode & LCD_RW) ? lcd->be->rw : 0);
+}
+
+/* 4비트 모드: 상위 니블(value & 0xF0)을 포트 바이트로 */
+static u8 lcd_nibble_port(struct hd44780* lcd, u8 value, u8 mode) {
+  return ((value >> 4) << lcd->be->d4_shift) | lcd_ctrl_pins(lcd, mode);
+}
+
+/* 데이터 없이 현재 백라이트 상태만 출력 */
+static void lcd_expander_idle(struct hd44780* lcd) {
+  if (lcd->be->eight_bit)
+    lcd_xfer_queue_ab(lcd, 0x00, 0x00);
+  else
+    lcd_xfer_queue(lcd, 0x00);
+  lcd_xfer_flush(lcd);
+}
+
+/* 초기화 시퀀스용: 4비트 모드는 상위 니블 하나, 8비트 모드는 바이트 하나를 래치 */
+static void lcd_write_init(struct hd44780* lcd, uint8_t value) {
+  u8 en = lcd->be->en;
+
+  if (lcd->be->eight_bit) {
+    lcd_xfer_queue_ab(lcd, value, 0x00);
+    lcd_xfer_queue_ab(lcd, value, en);   // EN=1
+    lcd_xfer_queue_ab(lcd, value, 0x00); // EN=0 (falling edge에서 래치)
+  }
+  else {
+    u8 port = lcd_nibble_port(lcd, value, 0);
+
+    lcd_xfer_queue(lcd, port);
+    lcd_xfer_queue(lcd, port | en);
+    lcd_xfer_queue(lcd, port);
+  }
+  lcd_xfer_flush(lcd);
+}
+
+/*
+ * 1바이트(명령/데이터)를 버퍼에 쌓는다. 전송은 lcd_xfer_flush()에서.
+ * - RS/RW는 EN 상승 전에 안정돼야 하므로 바뀔 때만 setup 바이트를 먼저 보냄
+ * - 데이터는 EN 하강 기준으로만 setup/hold가 필요하므로 EN=1과 같은 바이트에 실어도 됨
+ * - 다음 바이트의 EN 하강까지 최소 2바이트가 버스에 나가므로(100kHz에서 ~180us,
+ *   400kHz에서도 ~45us) 데이터 쓰기/대부분 명령의 실행 시간 37us는 버스가 보장함
+ *   → 앞 명령의 실행 시간이 그보다 길면(Clear/Home, 느린 패널) 먼저 flush해서 기다림
+ * 4비트 모드는 니블 두 번(4바이트), 8비트 모드(MCP23017)는 A/B 쌍 두 번(4바이트)
+ */
+static void lcd_send(struct hd44780* lcd, uint8_t value, uint8_t mode) {
+  enum lcd_op op = lcd_op_type(value, mode);
+  u8 en = lcd->be->en;
+
+  if (lcd->xexec_us > LCD_STREAM_GAP_US)
+    lcd_xfer_flush(lcd);
+  lcd->xop = op;
+  lcd->xexec_us = lcd_exec_time(lcd, op);
+  lcd->stats[op].ops++;
+
+  if (lcd->be->eight_bit) {
+    u8 ctrl = lcd_ctrl_pins(lcd, mode);
+
+    if (lcd->xctrl != mode)
+      lcd_xfer_queue_ab(lcd, value, ctrl);
+    lcd_xfer_queue_ab(lcd, value, ctrl | en);
+    lcd_xfer_queue_ab(lcd, value, ctrl);
+  }
+  else {
+    u8 highnib = lcd_nibble_port(lcd, value, mode);
+    u8 lownib = lcd_nibble_port(lcd, value << 4, mode);
+
+    if (lcd->xctrl != mode)
+      lcd_xfer_queue(lcd, highnib);
+    lcd_xfer_queue(lcd, highnib | en);
+    lcd_xfer_queue(lcd, highnib);
+    lcd_xfer_queue(lcd, lownib | en);
+    lcd_xfer_queue(lcd, lownib);
+  }
+  lcd->xctrl = mode;
+}
+
+/* 실행 시간 대기는 다음 전송 직전에 lcd_wait_ready()가 처리 */
+static void lcd_command(struct hd44780* lcd, uint8_t cmd) {
+  lcd_send(lcd, cmd, 0);
+  lcd_xfer_flush(lcd);
+}
+
+/* Entry Mode(I/D)에 따라 AC가 다음에 가리킬 주소 (2-line 모드 wrap 포함) */
+static u8 lcd_addr_next(struct hd44780* lcd, u8 addr) {
+  if (lcd->entry & 0x02) { // I/D=1: increment
+    if (addr == 0x27) return 0x40;
+    if (addr == 0x67) return 0x00;
+    return addr + 1;
+  }
+  if (addr == 0x00) return 0x67;
+  if (addr == 0x40) return 0x27;
+  return addr - 1;
+}
+
+static u8 lcd_pos_to_addr(struct hd44780* lcd, int pos) {
+  return lcd->row_offsets[pos / lcd->cols] + pos % lcd->cols;
+}
+
+/* 화면에 보이지 않는 주소면 -1 */
+static int lcd_addr_to_pos(struct hd44780* lcd, u8 addr) {
+  int row;
+
+  for (row = 0; row < lcd->rows; row++) {
+    if (addr >= lcd->row_offsets[row] && addr < lcd->row_offsets[row] + lcd->cols)
+      return row * lcd->cols + (addr - lcd->row_offsets[row]);
+  }
+  return -1;
+}
+
+/* 주소가 속한 행: 같은 DDRAM 줄에서 시작 주소가 addr 이하인 가장 가까운 행 */
+static int lcd_addr_row(struct hd44780* lcd, u8 addr) {
+  int row, best = 0;
+
+  for (row = 0; row < lcd->rows; row++) {
+    u8 off = lcd->row_offsets[row];
+
+    if ((off & 0x40) == (addr & 0x40) && off <= addr && off >= lcd->row_offsets[best])
+      best = row;
+  }
+  return best;
+}
+
+/* '\n': 다음 행 시작으로 (마지막 행이면 첫 행) */
+static u8 lcd_newline_addr(struct hd44780* lcd, u8 addr) {
+  return lcd->row_offsets[(lcd_addr_row(lcd, addr) + 1) % lcd->rows];
+}
+
+/* 프레임 셀 갱신, mmap 페이지에도 반영해 다음 스캔이 되돌리지 않게 함 (frame_lock) */
+static void lcd_frame_set(struct hd44780* lcd, u8 addr, u8 c) {
+  int pos = lcd_addr_to_pos(lcd, addr);
+
+  lcd->frame[addr] = c;
+  if (pos >= 0) {
+    WRITE_ONCE(lcd->mmap_buf[pos], c);
+    lcd->mmap_snap[pos] = c;
+  }
+}
+
+/*
+ * 셀 하나를 전송 버퍼에 쌓고, AC가 이미 그 주소면 Set DDRAM Address 생략.
+ * 호출자가 lcd_xfer_flush()로 한꺼번에 내보낸다. (lock)
+ */
+static void lcd_put_cell(struct hd44780* lcd, u8 addr, u8 c) {
+  if (lcd->ac != addr) {
+    lcd_send(lcd, 0x80 | addr, 0); // Set DDRAM Address
+    lcd->ac = addr;
+  }
+  lcd_send(lcd, c, LCD_RS);
+  lcd->ddram[addr] = c;
+  __clear_bit(addr, lcd->ddram_stale);
+  lcd->ac = lcd_addr_next(lcd, addr);
+}
+
+/*
+ * 전송 실패: 섀도우는 버퍼에 쌓을 때 이미 갱신됐으므로 어떤 셀이 실제로 나갔는지 모름.
+ * 모든 셀을 stale로 표시해 다음 flush가 프레임 전체를 다시 보내게 하고, AC도 다시 설정 (lock)
+ */
+static void lcd_shadow_invalidate(struct hd44780* lcd) {
+  bitmap_fill(lcd->ddram_stale, LCD_DDRAM_SIZE);
+  lcd->ac = LCD_AC_UNKNOWN;
+}
+
+static bool lcd_addr_valid(int addr) {
+  return (addr & 0x3F) < LCD_LINE_LEN;
+}
+
+/* 전송이 끝난 write_seq를 기록하고 fsync/poll 대기자를 깨움 */
+static void lcd_mark_flushed(struct hd44780* lcd, u64 seq, int err) {
+  spin_lock(&lcd->frame_lock);
+  if (err)
+    lcd->flush_err = err;
+  if (seq > lcd->flushed_seq)
+    lcd->flushed_seq = seq;
+  spin_unlock(&lcd->frame_lock);
+  wake_up_interruptible(&lcd->flush_wq);
+}
+
+/* fsync/poll이 기다릴 write_seq: 수동 commit 모드면 마지막 COMMIT까지만 (frame_lock) */
+static u64 lcd_target_seq(struct hd44780* lcd) {
+  return lcd->commit_mode == LCD_COMMIT_AUTO ? lcd->write_seq : lcd->commit_seq;
+}
+
+/*
+ * 프레임과 섀도우가 다른 셀만 전송 (lock).
+ * 수동 commit 모드면 마지막으로 commit된 프레임을 버스트 한 번으로 보냄
+ */
+static int lcd_flush_frame(struct hd44780* lcd) {
+  u8 frame[LCD_DDRAM_SIZE];
+  bool burst;
+  u64 seq;
+  int addr;
+  int ret, bret;
+
+  spin_lock(&lcd->frame_lock);
+  burst = lcd->commit_mode != LCD_COMMIT_AUTO;
+  memcpy(frame, burst ? lcd->committed : lcd->frame, sizeof(frame));
+  seq = lcd_target_seq(lcd);
+  spin_unlock(&lcd->frame_lock);
+
+  burst = burst && lcd_burst_ok(lcd);
+  if (burst) {
+    lcd_xfer_flush(lcd);
+    lcd_wait_ready(lcd);
+    lcd->burst = true;
+  }
+
+  for (addr = 0; addr < LCD_DDRAM_SIZE; addr++) {
+    if (lcd_addr_valid(addr) && (frame[addr] != lcd->ddram[addr] || test_bit(addr, lcd->ddram_stale)))
+      lcd_put_cell(lcd, addr, frame[addr]);
+  }
+
+  ret = lcd_xfer_flush(lcd);
+  if (burst) {
+    lcd->burst = false;
+    bret = lcd_burst_send(lcd);
+    if (!ret)
+      ret = bret;
+  }
+  if (ret < 0)
+    lcd_shadow_invalidate(lcd);
+  lcd_mark_flushed(lcd, seq, ret);
+
+  return ret;
+}
+
+static void lcd_flush_work_fn(struct kthread_work* work) {
+  struct hd44780* lcd = container_of(work, struct hd44780, flush_work);
+
+  mutex_lock(&lcd->lock);
+  if (!lcd->removed)
+    lcd_flush_frame(lcd);
+  mutex_unlock(&lcd->lock);
+}
+
+/* 프레임이 바뀜: 자동 모드면 바로 flush 요청, 수동 commit 모드면 COMMIT까지 보류 */
+static void lcd_frame_dirty(struct hd44780* lcd) {
+  if (READ_ONCE(lcd->commit_mode) == LCD_COMMIT_AUTO)
+    kthread_queue_work(lcd->worker, &lcd->flush_work);
+}
+
+/* 현재 back buffer를 commit, PACED면 다음 프레임 클럭(refresh_ms)에 반영 */
+static void lcd_commit(struct hd44780* lcd) {
+  unsigned int period = READ_ONCE(lcd->refresh_ms);
+  bool paced;
+
+  spin_lock(&lcd->frame_lock);
+  memcpy(lcd->committed, lcd->frame, sizeof(lcd->committed));
+  lcd->commit_seq = lcd->write_seq;
+  paced = lcd->commit_mode == LCD_COMMIT_PACED;
+  spin_unlock(&lcd->frame_lock);
+
+  if (paced && period)
+    kthread_queue_delayed_work(lcd->worker, &lcd->refresh_work, msecs_to_jiffies(period)); // 이미 예약돼 있으면 그대로
+  else
+    kthread_queue_work(lcd->worker, &lcd->flush_work);
+}
+
+/* mmap 페이지에서 지난 스캔 이후 바뀐 셀을 프레임으로 옮기고 flush 요청 */
+static void lcd_mmap_scan(struct hd44780* lcd) {
+  bool changed = false;
+  int pos;
+
+  spin_lock(&lcd->frame_lock);
+  for (pos = 0; pos < lcd->cells; pos++) {
+    u8 c = READ_ONCE(lcd->mmap_buf[pos]);
+
+    if (c != lcd->mmap_snap[pos]) {
+      lcd->mmap_snap[pos] = c;
+      lcd->frame[lcd_pos_to_addr(lcd, pos)] = c;
+      changed = true;
+    }
+  }
+  if (changed)
+    lcd->write_seq++;
+  spin_unlock(&lcd->frame_lock);
+
+  if (changed)
+    lcd_frame_dirty(lcd);
+}
+
+static void lcd_refresh_work_fn(struct kthread_work* work) {
+  struct hd44780* lcd = container_of(to_kthread_delayed_work(work), struct hd44780, refresh_work);
+  unsigned int period = READ_ONCE(lcd->refresh_ms);
+
+  if (READ_ONCE(lcd->removed))
+    return;
+  if (atomic_read(&lcd->mmap_users) > 0)
+    lcd_mmap_scan(lcd);
+
+  /* 프레임 클럭: PACED 모드에서 기다리던 commit 반영 */
+  spin_lock(&lcd->frame_lock);
+  if (lcd->commit_mode == LCD_COMMIT_PACED && lcd->commit_seq > lcd->flushed_seq)
+    kthread_queue_work(lcd->worker, &lcd->flush_work);
+  spin_unlock(&lcd->frame_lock);
+
+  if (period && atomic_read(&lcd->mmap_users) > 0)
+    kthread_queue_delayed_work(lcd->worker, &lcd->refresh_work, msecs_to_jiffies(period));
+}
+
+static void lcd_reset_shadow(struct hd44780* lcd) {
+  memset(lcd->ddram, ' ', sizeof(lcd->ddram));
+  bitmap_zero(lcd->ddram_stale, LCD_DDRAM_SIZE);
+  lcd->ac = 0;
+}
+
+/* Clear 이후: 프레임도 공백으로, 대기 중이던 write는 모두 반영된 것으로 처리 (lock) */
+static void lcd_reset_frame(struct hd44780* lcd) {
+  spin_lock(&lcd->frame_lock);
+  memset(lcd->frame, ' ', sizeof(lcd->frame));
+  memset(lcd->committed, ' ', sizeof(lcd->committed));
+  lcd->commit_seq = lcd->write_seq;
+  memset(lcd->mmap_buf, ' ', lcd->cells);
+  memset(lcd->mmap_snap, ' ', sizeof(lcd->mmap_snap));
+  lcd->flushed_seq = lcd->write_seq;
+  spin_unlock(&lcd->frame_lock);
+  wake_up_interruptible(&lcd->flush_wq);
+}
+
+static void lcd_init_hw(struct hd44780* lcd) {
+  msleep(50);
+
+  /* 데이터시트 초기화 절차 (Figure 23: 8-bit, Figure 24: 4-bit) */
+  lcd_write_init(lcd, 0x30); lcd_delay_us(4100);
+  lcd_write_init(lcd, 0x30); lcd_delay_us(100);
+  lcd_write_init(lcd, 0x30); lcd_delay_us(lcd->timing.exec_us);
+
+  if (lcd->be->eight_bit) {
+    lcd_command(lcd, 0x38); // Function Set: 8-bit, 2 line
+  }
+  else {
+    lcd_write_init(lcd, 0x20); lcd_delay_us(lcd->timing.exec_us);
+    lcd_command(lcd, 0x28); // Function Set: 4-bit, 2 line (4행 패널도 2-line 모드)
+  }
+  lcd_command(lcd, 0x01); // Clear
+  lcd_command(lcd, 0x06); // Entry mode: increment
+  lcd_command(lcd, 0x02); // Home
+
+  lcd->entry = LCD_ENTRY_RIGHT;
+  lcd_reset_shadow(lcd);
+  lcd_reset_frame(lcd);
+}
+
+/* 글리프 문자 코드: 0~7, CGRAM 주소 비트 3은 무시되므로 8~15도 같은 슬롯 */
+static bool lcd_is_glyph_char(u8 c, int slot) {
+  return (c & 0xF7) == slot;
+}
+
+/* 프레임(보여야 할 화면)에서 slot을 쓰는 셀을 공백으로 바꿈, 바뀐 셀이 있으면 true (frame_lock) */
+static bool lcd_glyph_unref(struct hd44780* lcd, int slot) {
+  bool changed = false;
+  int pos;
+
+  for (pos = 0; pos < lcd->cells; pos++) {
+    u8 addr = lcd_pos_to_addr(lcd, pos);
+
+    if (lcd_is_glyph_char(lcd->frame[addr], slot)) {
+      lcd_frame_set(lcd, addr, ' ');
+      changed = true;
+    }
+    if (lcd->commit_mode != LCD_COMMIT_AUTO && lcd_is_glyph_char(lcd->committed[addr], slot)) {
+      lcd->committed[addr] = ' ';
+      changed = true;
+    }
+  }
+  if (changed)
+    lcd->write_seq++;
+  return changed;
+}
+
+/* 교체할 슬롯: 빈 슬롯 → 화면에 없는 슬롯 중 LRU → 전체 LRU 순 (lock) */
+static int lcd_glyph_victim(struct hd44780* lcd) {
+  int slot, victim = -1, unused = -1;
+
+  for (slot = 0; slot < LCD_GLYPH_SLOTS; slot++) {
+    int pos;
+    bool on_screen = false;
+
+    if (!lcd->glyphs[slot].valid)
+      return slot;
+
+    spin_lock(&lcd->frame_lock);
+    for (pos = 0; pos < lcd->cells && !on_screen; pos++) {
+      u8 addr = lcd_pos_to_addr(lcd, pos);
+
+      on_screen = lcd_is_glyph_char(lcd->frame[addr], slot) ||
+        (lcd->commit_mode != LCD_COMMIT_AUTO && lcd_is_glyph_char(lcd->committed[addr], slot));
+    }
+    spin_unlock(&lcd->frame_lock);
+
+    if (!on_screen && (unused < 0 || lcd->glyphs[slot].last_used < lcd->glyphs[unused].last_used))
+      unused = slot;
+    if (victim < 0 || lcd->glyphs[slot].last_used < lcd->glyphs[victim].last_used)
+      victim = slot;
+  }
+
+  return unused >= 0 ? unused : victim;
+}
+
+/* 비트맵에 해당하는 슬롯 반환, 처음 보는 비트맵일 때만 CGRAM 프로그래밍 (lock) */
+static int lcd_glyph_get(struct hd44780* lcd, const u8* bitmap) {
+  u8 rows[LCD_GLYPH_ROWS];
+  u32 hash;
+  int slot, i, ret;
+  bool unref;
+
+  for (i = 0; i < LCD_GLYPH_ROWS; i++)
+    rows[i] = bitmap[i] & 0x1F; // 5x8: 하위 5비트만 사용
+  hash = jhash(rows, sizeof(rows), 0);
+
+  for (slot = 0; slot < LCD_GLYPH_SLOTS; slot++) {
+    struct lcd_glyph_slot* g = &lcd->glyphs[slot];
+
+    if (g->valid && g->hash == hash && !memcmp(g->bitmap, rows, sizeof(rows))) {
+      g->last_used = ++lcd->glyph_clock;
+      lcd->glyph_hits++;
+      return slot;
+    }
+  }
+
+  slot = lcd_glyph_victim(lcd);
+  if (lcd->glyphs[slot].valid) {
+    spin_lock(&lcd->frame_lock);
+    unref = lcd_glyph_unref(lcd, slot);
+    spin_unlock(&lcd->frame_lock);
+
+    /* 화면에 보이던 슬롯: 옛 글리프를 쓰던 셀을 먼저 지워야 CGRAM을 바꿀 때 엉뚱한 모양이 보이지 않음 */
+    if (unref) {
+      lcd->glyph_evictions++;
+      lcd_flush_frame(lcd);
+    }
+  }
+
+  lcd_send(lcd, 0x40 | (slot << 3), 0); // Set CGRAM Address
+  for (i = 0; i < LCD_GLYPH_ROWS; i++)
+    lcd_send(lcd, rows[i], LCD_RS);
+  ret = lcd_xfer_flush(lcd);
+  lcd->ac = LCD_AC_UNKNOWN; // AC가 CGRAM을 가리킴 → 다음 DDRAM 쓰기에서 주소 재설정
+
+  if (ret < 0) {
+    lcd->glyphs[slot].valid = false;
+    return ret;
+  }
+
+  lcd->glyphs[slot].valid = true;
+  lcd->glyphs[slot].hash = hash;
+  memcpy(lcd->glyphs[slot].bitmap, rows, sizeof(rows));
+  lcd->glyphs[slot].last_used = ++lcd->glyph_clock;
+  lcd->glyph_uploads++;
+
+  return slot;
+}
+
+static int lcd_glyphs_show(struct seq_file* m, void* v) {
+  struct hd44780* lcd = m->private;
+  int slot, i;
+
+  mutex_lock(&lcd->lock);
+  seq_printf(m, "hits: %llu\nuploads: %llu\nevictions: %llu\n",
+    lcd->glyph_hits, lcd->glyph_uploads, lcd->glyph_evictions);
+  for (slot = 0; slot < LCD_GLYPH_SLOTS; slot++) {
+    struct lcd_glyph_slot* g = &lcd->glyphs[slot];
+
+    if (!g->valid)
+      continue;
+    seq_printf(m, "slot %d:", slot);
+    for (i = 0; i < LCD_GLYPH_ROWS; i++)
+      seq_printf(m, " %02x", g->bitmap[i]);
+    seq_printf(m, " (last_used %llu)\n", g->last_used);
+  }
+  mutex_unlock(&lcd->lock);
+
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lcd_glyphs);
+
+/* 마퀴 글자를 프레임(수동 commit 모드면 commit된 프레임까지)에 씀 (frame_lock) */
+static void lcd_marquee_set(struct hd44780* lcd, u8 addr, u8 c) {
+  lcd_frame_set(lcd, addr, c);
+  if (lcd->commit_mode != LCD_COMMIT_AUTO)
+    lcd->committed[addr] = c;
+}
+
+/* 소프트웨어 마퀴: 행의 보이는 칸만 현재 offset으로 다시 씀 (frame_lock) */
+static void lcd_marquee_render(struct hd44780* lcd, int row) {
+  struct lcd_marquee_row* mq = &lcd->marquee[row];
+  int col;
+
+  for (col = 0; col < lcd->cols; col++)
+    lcd_marquee_set(lcd, lcd->row_offsets[row] + col, mq->text[(mq->offset + col) % LCD_LINE_LEN]);
+}
+
+/* 모든 행이 같은 주기/방향으로 흐르고, 행마다 DDRAM 한 줄(40자)을 통째로 쓸 수 있을 때 */
+static bool lcd_marquee_hw_ok(struct hd44780* lcd) {
+  int row;
+
+  if (lcd->rows > 2)
+    return false;
+  for (row = 0; row < lcd->rows; row++) {
+    if (!lcd->marquee[row].active ||
+      lcd->marquee[row].period_ms != lcd->marquee[0].period_ms ||
+      lcd->marquee[row].dir != lcd->marquee[0].dir)
+      return false;
+  }
+  return true;
+}
+
+static void lcd_marquee_arm(struct hd44780* lcd) {
+  ktime_t next = KTIME_MAX;
+  int row;
+
+  for (row = 0; row < lcd->rows; row++) {
+    if (lcd->marquee[row].active && ktime_before(lcd->marquee[row].next, next))
+      next = lcd->marquee[row].next;
+  }
+
+  hrtimer_cancel(&lcd->marquee_timer);
+  if (next != KTIME_MAX)
+    hrtimer_start(&lcd->marquee_timer, next, HRTIMER_MODE_ABS);
+}
+
+/*
+ * 마퀴 설정이 바뀐 뒤 하드웨어/소프트웨어 방식을 다시 고르고 화면에 반영 (lock).
+ * 방식이 바뀌면 Return Home으로 shift를 0으로 되돌리고 모든 링을 처음부터 시작
+ */
+static void lcd_marquee_update(struct hd44780* lcd) {
+  bool hw = lcd_marquee_hw_ok(lcd);
+  ktime_t now = ktime_get();
+  int row, i;
+
+  if (hw != lcd->marquee_hw) {
+    if (lcd->marquee_hw || hw) {
+      lcd_command(lcd, 0x02); // Return Home: display shift 해제
+      lcd->ac = 0;
+    }
+    for (row = 0; row < lcd->rows; row++) {
+      lcd->marquee[row].offset = 0;
+      lcd->marquee[row].next = ktime_add_ms(now, lcd->marquee[row].period_ms);
+    }
+    lcd->marquee_hw = hw;
+  }
+
+  spin_lock(&lcd->frame_lock);
+  for (row = 0; row < lcd->rows; row++) {
+    if (!lcd->marquee[row].active)
+      continue;
+    if (hw) {
+      for (i = 0; i < LCD_LINE_LEN; i++)
+        lcd_marquee_set(lcd, lcd->row_offsets[row] + i, lcd->marquee[row].text[i]);
+    }
+    else {
+      lcd_marquee_render(lcd, row);
+    }
+  }
+  lcd->write_seq++;
+  spin_unlock(&lcd->frame_lock);
+
+  lcd_flush_frame(lcd);
+  lcd_marquee_arm(lcd);
+}
+
+/* 타이머 콜백(인터럽트 문맥)에서는 I2C를 쓸 수 없으므로 worker에 넘김 */
+static enum hrtimer_restart lcd_marquee_timer_fn(struct hrtimer* timer) {
+  struct hd44780* lcd = container_of(timer, struct hd44780, marquee_timer);
+
+  kthread_queue_work(lcd->worker, &lcd->marquee_work);
+  return HRTIMER_NORESTART;
+}
+
+static void lcd_marquee_step(struct lcd_marquee_row* mq, ktime_t now) {
+  mq->offset = (mq->offset + (mq->dir == LCD_MARQUEE_LEFT ? 1 : LCD_LINE_LEN - 1)) % LCD_LINE_LEN;
+  mq->next = ktime_add_ms(mq->next, mq->period_ms);
+  if (ktime_before(mq->next, now)) // 밀렸으면 건너뛰고 지금부터 다시
+    mq->next = ktime_add_ms(now, mq->period_ms);
+}
+
+static void lcd_marquee_work_fn(struct kthread_work* work) {
+  struct hd44780* lcd = container_of(work, struct hd44780, marquee_work);
+  ktime_t now = ktime_get();
+  bool changed = false;
+  int row;
+
+  mutex_lock(&lcd->lock);
+  if (lcd->removed) {
+    mutex_unlock(&lcd->lock);
+    return;
+  }
+  if (lcd->marquee_hw) {
+    /* 모든 행이 같은 주기이므로 0행 기준, 명령 1바이트로 화면 전체 이동 */
+    if (lcd->marquee[0].active && !ktime_before(now, lcd->marquee[0].next)) {
+      lcd_command(lcd, lcd->marquee[0].dir == LCD_MARQUEE_LEFT ? 0x18 : 0x1C);
+      for (row = 0; row < lcd->rows; row++)
+        lcd_marquee_step(&lcd->marquee[row], now);
+    }
+  }
+  else {
+    spin_lock(&lcd->frame_lock);
+    for (row = 0; row < lcd->rows; row++) {
+      struct lcd_marquee_row* mq = &lcd->marquee[row];
+
+      if (!mq->active || ktime_before(now, mq->next))
+        continue;
+      lcd_marquee_step(mq, now);
+      lcd_marquee_render(lcd, row);
+      changed = true;
+    }
+    if (changed)
+      lcd->write_seq++;
+    spin_unlock(&lcd->frame_lock);
+
+    if (changed)
+      lcd_flush_frame(lcd);
+  }
+  lcd_marquee_arm(lcd);
+  mutex_unlock(&lcd->lock);
+}
+
+/* 모든 마퀴 중지, 화면 내용은 마지막 상태로 남음 (lock) */
+static void lcd_marquee_stop_all(struct hd44780* lcd) {
+  int row;
+
+  for (row = 0; row < LCD_MAX_ROWS; row++)
+    lcd->marquee[row].active = false;
+  if (lcd->marquee_hw) {
+    lcd_command(lcd, 0x02);
+    lcd->ac = 0;
+    lcd->marquee_hw = false;
+  }
+  hrtimer_cancel(&lcd->marquee_timer);
+}
+
+static int lcd_marquee_ioctl(struct hd44780* lcd, unsigned int cmd, unsigned long arg) {
+  switch (cmd) {
+  case LCD_IOCTL_MARQUEE_START: {
+    struct lcd_marquee req;
+    struct lcd_marquee_row* mq;
+
+    if (copy_from_user(&req, (void __user*)arg, sizeof(req)))
+      return -EFAULT;
+    if (req.row < 0 || req.row >= lcd->rows || req.len < 0 || req.len > LCD_LINE_LEN ||
+      req.period_ms < LCD_MARQUEE_MIN_MS ||
+      (req.dir != LCD_MARQUEE_LEFT && req.dir != LCD_MARQUEE_RIGHT))
+      return -EINVAL;
+
+    mq = &lcd->marquee[req.row];
+    memset(mq->text, ' ', sizeof(mq->text));
+    memcpy(mq->text, req.text, req.len);
+    mq->period_ms = req.period_ms;
+    mq->dir = req.dir;
+    mq->offset = 0;
+    mq->next = ktime_add_ms(ktime_get(), req.period_ms);
+    mq->active = true;
+    break;
+  }
+
+  case LCD_IOCTL_MARQUEE_STOP: {
+    int row = (int)arg;
+
+    if (row == -1) {
+      lcd_marquee_stop_all(lcd);
+      return 0;
+    }
+    if (row < 0 || row >= lcd->rows)
+      return -EINVAL;
+    lcd->marquee[row].active = false;
+    break;
+  }
+
+  case LCD_IOCTL_MARQUEE_SPEED: {
+    struct lcd_marquee_speed req;
+
+    if (copy_from_user(&req, (void __user*)arg, sizeof(req)))
+      return -EFAULT;
+    if (req.row < 0 || req.row >= lcd->rows || req.period_ms < LCD_MARQUEE_MIN_MS)
+      return -EINVAL;
+    if (!lcd->marquee[req.row].active)
+      return -ENOENT;
+    lcd->marquee[req.row].period_ms = req.period_ms;
+    lcd->marquee[req.row].next = ktime_add_ms(ktime_get(), req.period_ms);
+    break;
+  }
+  }
+
+  lcd_marquee_update(lcd);
+  return 0;
+}
+
+/* === 파일별 창 === */
+static int lcd_region_size(const struct lcd_region* r) {
+  return r->width * r->height;
+}
+
+/* 영역 안 위치 → 화면 셀 위치 */
+static int lcd_region_cell(struct hd44780* lcd, const struct lcd_region* r, int pos) {
+  return (r->row + pos / r->width) * lcd->cols + r->col + pos % r->width;
+}
+
+static void lcd_file_region(struct lcd_file* lf, struct lcd_region* r) {
+  spin_lock(&lf->lcd->frame_lock);
+  *r = lf->win;
+  spin_unlock(&lf->lcd->frame_lock);
+}
+
+static bool lcd_region_overlap(const struct lcd_region* a, const struct lcd_region* b) {
+  return a->row < b->row + b->height && b->row < a->row + a->height &&
+    a->col < b->col + b->width && b->col < a->col + a->width;
+}
+
+/* 창 설정/해제 (크기 0), 다른 파일의 창과 겹치면 -EBUSY (lock) */
+static int lcd_set_window(struct lcd_file* lf, const struct lcd_window* req) {
+  struct hd44780* lcd = lf->lcd;
+  struct lcd_region r = { req->row, req->col, req->width, req->height };
+  struct lcd_file* other;
+
+  if (r.width == 0 && r.height == 0) {
+    r = (struct lcd_region) { 0, 0, lcd->cols, lcd->rows };
+  }
+  else {
+    if (r.row < 0 || r.col < 0 || r.width <= 0 || r.height <= 0 ||
+      r.row + r.height > lcd->rows || r.col + r.width > lcd->cols)
+      return -EINVAL;
+
+    list_for_each_entry(other, &lcd->windows, node) {
+      if (other != lf && lcd_region_overlap(&r, &other->win))
+        return -EBUSY;
+    }
+  }
+
+  if (lf->windowed)
+    list_del(&lf->node);
+  lf->windowed = req->width || req->height;
+  if (lf->windowed)
+    list_add_tail(&lf->node, &lcd->windows);
+
+  spin_lock(&lcd->frame_lock);
+  lf->win = r;
+  lf->nfields = 0; // 레이아웃 위치는 창 기준이므로 다시 등록해야 함
+  spin_unlock(&lcd->frame_lock);
+  return 0;
+}
 
-/* devnode → /dev/i2c_lcd 자동 생성, 권한 0666 */
-static char* lcd_devnode(const struct device* dev, umode_t* mode) {
-  if (mode)
-    *mode = 0666;
-  return NULL;
+/* 창 영역을 공백으로 (창을 잡은 파일의 CLEAR), 하드웨어 Clear 대신 바뀐 셀만 전송 */
+static void lcd_clear_region(struct hd44780* lcd, const struct lcd_region* r) {
+  int pos;
+
+  spin_lock(&lcd->frame_lock);
+  for (pos = 0; pos < lcd_region_size(r); pos++)
+    lcd_frame_set(lcd, lcd_pos_to_addr(lcd, lcd_region_cell(lcd, r, pos)), ' ');
+  lcd->write_seq++;
+  spin_unlock(&lcd->frame_lock);
+
+  lcd_frame_dirty(lcd);
 }
 
-/* === 저수준 LCD 제어 함수 (PCF8574 기반) === */
-static void lcd_expander_write(uint8_t data) {
-  uint8_t buf = data | (backlight ? 0x08 : 0x00);
-  i2c_master_send(lcd_client, &buf, 1);
+/* === 수명 === */
+
+/* 마지막 참조(probe, 열린 파일, mmap)가 풀리면 worker와 메모리 해제. I2C는 remove에서 끝남 */
+static void lcd_free(struct kref* kref) {
+  struct hd44780* lcd = container_of(kref, struct hd44780, kref);
+
+  hrtimer_cancel(&lcd->marquee_timer);
+  kthread_cancel_delayed_work_sync(&lcd->refresh_work);
+  kthread_destroy_worker(lcd->worker);
+  free_page((unsigned long)lcd->mmap_buf); // 매핑이 남아 있으면 페이지 참조는 매핑이 유지
+  kfree(lcd);
 }
 
-static void lcd_pulse_enable(uint8_t data) {
-  lcd_expander_write(data | 0x04); // EN=1
-  udelay(1);
-  lcd_expander_write(data & ~0x04); // EN=0
-  udelay(50);
+static void lcd_put(struct hd44780* lcd) {
+  kref_put(&lcd->kref, lcd_free);
 }
 
-static void lcd_write4bits(uint8_t value) {
-  lcd_expander_write(value);
-  lcd_pulse_enable(value);
+static bool lcd_gone(struct hd44780* lcd) {
+  return READ_ONCE(lcd->removed);
 }
 
-static void lcd_send(uint8_t value, uint8_t mode) {
-  uint8_t highnib = value & 0xF0;
-  uint8_t lownib = (value << 4) & 0xF0;
-  lcd_write4bits(highnib | mode);
-  lcd_write4bits(lownib | mode);
+/* === file_operations === */
+static int lcd_open(struct inode* inode, struct file* file) {
+  struct hd44780* lcd;
+  struct lcd_file* lf;
+
+  mutex_lock(&lcd_table_lock);
+  lcd = lcd_table[iminor(inode)];
+  if (lcd)
+    kref_get(&lcd->kref);
+  mutex_unlock(&lcd_table_lock);
+  if (!lcd)
+    return -ENODEV;
+
+  lf = kzalloc(sizeof(*lf), GFP_KERNEL);
+  if (!lf) {
+    lcd_put(lcd);
+    return -ENOMEM;
+  }
+
+  lf->lcd = lcd;
+  lf->win = (struct lcd_region) { 0, 0, lcd->cols, lcd->rows };
+  INIT_LIST_HEAD(&lf->node);
+  file->private_data = lf;
+  return 0;
 }
 
-static void lcd_command(uint8_t cmd) {
-  lcd_send(cmd, 0);
-  mdelay(2);
+static int lcd_release(struct inode* inode, struct file* file) {
+  struct lcd_file* lf = file->private_data;
+  struct hd44780* lcd = lf->lcd;
+
+  mutex_lock(&lcd->lock);
+  if (lf->windowed)
+    list_del(&lf->node);
+  mutex_unlock(&lcd->lock);
+
+  kfree(lf);
+  lcd_put(lcd);
+  return 0;
 }
 
-static void lcd_data(uint8_t data) {
-  lcd_send(data, 0x01); // RS=1
-  mdelay(2);
+/* 섀도우 내용을 셀 위치(창이 있으면 창 기준) 순서로 반환, I2C 통신 없음 */
+static ssize_t lcd_read(struct file* file, char __user* buf, size_t len, loff_t* off) {
+  struct lcd_file* lf = file->private_data;
+  struct hd44780* lcd = lf->lcd;
+  char kbuf[LCD_MAX_CELLS];
+  struct lcd_region r;
+  int size;
+  int pos;
+
+  if (lcd_gone(lcd))
+    return -ENODEV;
+  lcd_file_region(lf, &r);
+  size = lcd_region_size(&r);
+  if (*off >= size)
+    return 0;
+
+  mutex_lock(&lcd->lock);
+  for (pos = 0; pos < size; pos++)
+    kbuf[pos] = lcd->ddram[lcd_pos_to_addr(lcd, lcd_region_cell(lcd, &r, pos))];
+  mutex_unlock(&lcd->lock);
+
+  len = min(len, (size_t)(size - *off));
+  if (copy_to_user(buf, kbuf + *off, len))
+    return -EFAULT;
+
+  *off += len;
+  return len;
 }
 
-static void lcd_init_hw(void) {
-  msleep(50);
+/* 한 번의 write가 쓸 수 있는 최대 바이트: 모든 셀 + 행마다 '\n' */
+#define LCD_TEXT_MAX  (LCD_MAX_CELLS + LCD_MAX_ROWS)
 
-  lcd_write4bits(0x30); msleep(5);
-  lcd_write4bits(0x30); msleep(5);
-  lcd_write4bits(0x30); msleep(5);
+/*
+ * 영역 안 위치 *ppos부터 텍스트를 프레임에 씀, 소비한 바이트 수 반환 (frame_lock).
+ * '\n'은 영역의 다음 행 시작, 영역 끝(또는 I/D=0에서 처음)을 넘으면 멈춤
+ */
+static size_t lcd_frame_text(struct hd44780* lcd, const struct lcd_region* r, int* ppos,
+  const u8* text, size_t len) {
+  int step = (lcd->entry & 0x02) ? 1 : -1;
+  int size = lcd_region_size(r);
+  int pos = *ppos;
+  size_t i;
 
-  lcd_write4bits(0x20); msleep(5);
+  for (i = 0; i < len && pos >= 0 && pos < size; i++) {
+    if (text[i] == '\n') {
+      pos = (pos / r->width + 1) * r->width;
+      continue;
+    }
+    lcd_frame_set(lcd, lcd_pos_to_addr(lcd, lcd_region_cell(lcd, r, pos)), text[i]);
+    pos += step;
+  }
 
-  lcd_command(0x28); // Function Set: 4-bit, 2 line
-  lcd_command(0x01); // Clear
-  lcd_command(0x06); // Entry mode: increment
-  lcd_command(0x02); // Home
+  *ppos = max(pos, 0);
+  return i;
 }
 
-/* === file_operations === */
-static ssize_t lcd_write(struct file* file, const char __user* buf, size_t len, loff_t* off) {
-  char kbuf[64];
-  size_t to_copy = min(len, sizeof(kbuf) - 1);
+/*
+ * Entry Mode의 display shift(S=1)는 write마다 화면 전체가 밀리므로 셀 비교로 생략하거나
+ * 순서를 바꿀 수 없음 → 밀린 프레임을 먼저 내보낸 뒤 그대로 동기 전송.
+ * 이때는 하드웨어 AC처럼 DDRAM 주소를 따라가며 화면 밖 주소에도 씀
+ */
+static int lcd_write_through(struct hd44780* lcd, int* ppos, const u8* text, size_t len) {
+  u8 addr = lcd_pos_to_addr(lcd, *ppos); // 화면 기준 위치
   size_t i;
+  int pos;
+  int ret;
+
+  mutex_lock(&lcd->lock);
+  if (lcd->removed) {
+    mutex_unlock(&lcd->lock);
+    return -ENODEV;
+  }
+  lcd_flush_frame(lcd);
+  for (i = 0; i < len; i++) {
+    if (text[i] == '\n') {
+      addr = lcd_newline_addr(lcd, addr);
+      continue;
+    }
+    spin_lock(&lcd->frame_lock);
+    lcd_frame_set(lcd, addr, text[i]);
+    spin_unlock(&lcd->frame_lock);
+
+    lcd_put_cell(lcd, addr, text[i]);
+    addr = lcd_addr_next(lcd, addr);
+  }
+  ret = lcd_xfer_flush(lcd);
+  if (ret < 0)
+    lcd_shadow_invalidate(lcd);
+  mutex_unlock(&lcd->lock);
+
+  pos = lcd_addr_to_pos(lcd, addr);
+  *ppos = pos >= 0 ? pos : lcd->cells;
+  return ret;
+}
+
+/*
+ * 파일 위치 = 셀 위치 (pwrite/lseek, writev는 iovec을 이어 붙인 하나의 텍스트).
+ * 창을 잡은 파일은 창 기준 위치이고 창 밖에는 쓰지 않음.
+ * 프레임만 갱신하고 바로 반환, 실제 전송은 flush worker가 처리하므로
+ * 여러 파일이 동시에 써도 한 번의 flush로 합쳐짐.
+ * 영역 끝을 넘는 부분은 짧은 쓰기로 알리고, 이미 끝이면 -ENOSPC
+ */
+static ssize_t lcd_write_iter(struct kiocb* iocb, struct iov_iter* from) {
+  struct lcd_file* lf = iocb->ki_filp->private_data;
+  struct hd44780* lcd = lf->lcd;
+  u8 kbuf[LCD_TEXT_MAX];
+  size_t len = min(iov_iter_count(from), sizeof(kbuf));
+  struct lcd_region r;
+  size_t done;
+  int pos;
+  int ret;
+
+  if (lcd_gone(lcd))
+    return -ENODEV;
+  if (len == 0)
+    return 0;
+  lcd_file_region(lf, &r);
+  if (iocb->ki_pos >= lcd_region_size(&r))
+    return -ENOSPC;
+  pos = iocb->ki_pos;
 
-  if (copy_from_user(kbuf, buf, to_copy)) {
+  if (copy_from_iter(kbuf, len, from) != len)
     return -EFAULT;
+
+  if (READ_ONCE(lcd->entry) & 0x01) {
+    if (lf->windowed)
+      return -EINVAL; // display shift는 화면 전체를 밀기 때문에 창과 함께 쓸 수 없음
+    ret = lcd_write_through(lcd, &pos, kbuf, len);
+    if (ret < 0)
+      return ret;
+    iocb->ki_pos = pos;
+    return len;
   }
 
-  kbuf[to_copy] = '\0';
+  spin_lock(&lcd->frame_lock);
+  done = lcd_frame_text(lcd, &lf->win, &pos, kbuf, len);
+  lcd->write_seq++;
+  spin_unlock(&lcd->frame_lock);
+
+  lcd_frame_dirty(lcd);
+
+  iocb->ki_pos = pos;
+  iov_iter_revert(from, len - done); // 쓰지 못한 나머지는 돌려줌
+  return done;
+}
+
+/* 위치는 0 ~ 영역 크기 (영역 끝) */
+static loff_t lcd_llseek(struct file* file, loff_t offset, int whence) {
+  struct lcd_file* lf = file->private_data;
+  struct lcd_region r;
+
+  lcd_file_region(lf, &r);
+  return fixed_size_llseek(file, offset, whence, lcd_region_size(&r));
+}
+
+/*
+ * 여러 {위치, 길이, 데이터} 구간을 한 번의 시스템 콜로 반영.
+ * 모든 구간을 같은 락 안에서 프레임에 쓰고 flush를 한 번만 요청하므로
+ * 일부 필드만 바뀐 중간 상태가 LCD에 나가지 않음.
+ * 프레임에 쓴 바이트 합을 반환 (영역 끝을 넘은 부분은 빠짐, write의 짧은 쓰기와 같음)
+ */
+static int lcd_batch(struct lcd_file* lf, const struct lcd_batch __user* ubatch) {
+  struct hd44780* lcd = lf->lcd;
+  struct lcd_region r;
+  struct lcd_batch batch;
+  struct lcd_seg* segs;
+  u8* text;
+  u32 i;
+  int ret = 0;
+
+  if (copy_from_user(&batch, ubatch, sizeof(batch)))
+    return -EFAULT;
+  if (batch.nsegs == 0)
+    return 0;
+  if (batch.nsegs > LCD_BATCH_MAX_SEGS)
+    return -EINVAL;
+  if (READ_ONCE(lcd->entry) & 0x01)
+    return -EINVAL; // display shift 모드는 순서대로 동기 전송해야 함
+
+  segs = memdup_array_user(u64_to_user_ptr(batch.segs), batch.nsegs, sizeof(*segs));
+  if (IS_ERR(segs))
+    return PTR_ERR(segs);
+
+  text = kmalloc_array(batch.nsegs, LCD_TEXT_MAX, GFP_KERNEL);
+  if (!text) {
+    ret = -ENOMEM;
+    goto out;
+  }
 
-  for (i = 0; i < to_copy; i++) {
-    if (kbuf[i] == '\n') {
-      lcd_command(0xC0); // 2행 시작
+  /* 사용자 메모리 복사는 락 밖에서 */
+  lcd_file_region(lf, &r);
+  for (i = 0; i < batch.nsegs; i++) {
+    if (segs[i].pos >= lcd_region_size(&r) || segs[i].len > LCD_TEXT_MAX) {
+      ret = -EINVAL;
+      goto out;
     }
-    else {
-      lcd_data(kbuf[i]);
+    if (copy_from_user(text + i * LCD_TEXT_MAX, u64_to_user_ptr(segs[i].data), segs[i].len)) {
+      ret = -EFAULT;
+      goto out;
+    }
+  }
+
+  spin_lock(&lcd->frame_lock);
+  for (i = 0; i < batch.nsegs; i++) {
+    int pos = segs[i].pos;
+
+    ret += lcd_frame_text(lcd, &lf->win, &pos, text + i * LCD_TEXT_MAX, segs[i].len);
+  }
+  lcd->write_seq++;
+  spin_unlock(&lcd->frame_lock);
+
+  lcd_frame_dirty(lcd);
+
+out:
+  kfree(text);
+  kfree(segs);
+  return ret;
+}
+
+/* === 레이아웃 템플릿 === */
+#define LCD_LAYOUT_MAX_WIDTH  16
+#define LCD_LAYOUT_MAX_PREC   6
+
+static const u32 lcd_pow10[LCD_LAYOUT_MAX_PREC + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+/*
+ * 템플릿을 영역 기준 셀로 펼침: cells[pos]는 리터럴 문자, 필드 자리는 공백,
+ * 템플릿이 덮지 않는 셀은 0. 필드는 한 행 안에 들어가야 함
+ */
+static int lcd_layout_parse(const struct lcd_region* r, const char* fmt,
+  struct lcd_layout_field* fields, u8* cells) {
+  int size = lcd_region_size(r);
+  int nfields = 0;
+  int pos = 0;
+
+  memset(cells, 0, size);
+  for (; *fmt; fmt++) {
+    struct lcd_layout_field* f;
+    int width = 0, prec = 0;
+
+    if (*fmt == '\n') {
+      pos = (pos / r->width + 1) * r->width;
+      continue;
+    }
+    if (*fmt != '%' || fmt[1] == '%') {
+      if (pos >= size)
+        return -EINVAL;
+      fmt += (*fmt == '%');
+      cells[pos++] = *fmt;
+      continue;
+    }
+
+    /* %[width][.prec]f / %[width]d */
+    for (fmt++; isdigit(*fmt); fmt++)
+      width = width * 10 + (*fmt - '0');
+    if (*fmt == '.') {
+      for (fmt++; isdigit(*fmt); fmt++)
+        prec = prec * 10 + (*fmt - '0');
+      if (*fmt != 'f' || prec > LCD_LAYOUT_MAX_PREC)
+        return -EINVAL;
     }
+    if ((*fmt != 'd' && *fmt != 'f') || width < 1 || width > LCD_LAYOUT_MAX_WIDTH)
+      return -EINVAL;
+    if (nfields == LCD_LAYOUT_MAX_FIELDS || pos % r->width + width > r->width || pos + width > size)
+      return -EINVAL;
+
+    f = &fields[nfields++];
+    f->pos = pos;
+    f->width = width;
+    f->prec = prec;
+    f->fixed = *fmt == 'f';
+    memset(cells + pos, ' ', width);
+    pos += width;
+  }
+  return nfields;
+}
+
+/* 값을 오른쪽 정렬로 width칸에, 넘치면 '#'로 채움 */
+static void lcd_layout_format(const struct lcd_layout_field* f, s32 val, u8* out) {
+  char num[16];
+  int len;
+
+  if (f->fixed && f->prec) {
+    u32 mag = val < 0 ? -(u32)val : val;
+    u32 scale = lcd_pow10[f->prec];
+
+    len = snprintf(num, sizeof(num), "%s%u.%0*u", val < 0 ? "-" : "",
+      mag / scale, f->prec, mag % scale);
+  }
+  else {
+    len = snprintf(num, sizeof(num), "%d", val);
+  }
+
+  if (len > f->width) {
+    memset(out, '#', f->width);
+    return;
+  }
+  memset(out, ' ', f->width - len);
+  memcpy(out + f->width - len, num, len);
+}
+
+/* 템플릿 등록: 리터럴을 프레임에 쓰고 필드 자리는 공백으로 (lock) */
+static int lcd_layout_set(struct lcd_file* lf, const struct lcd_layout __user* ulayout) {
+  struct hd44780* lcd = lf->lcd;
+  struct lcd_layout_field fields[LCD_LAYOUT_MAX_FIELDS];
+  u8 cells[LCD_MAX_CELLS];
+  struct lcd_layout* layout;
+  int nfields;
+  int pos;
+
+  layout = memdup_user(ulayout, sizeof(*layout));
+  if (IS_ERR(layout))
+    return PTR_ERR(layout);
+  layout->fmt[sizeof(layout->fmt) - 1] = '\0';
+
+  nfields = lcd_layout_parse(&lf->win, layout->fmt, fields, cells); // 창은 lock 아래에서만 바뀜
+  kfree(layout);
+  if (nfields < 0)
+    return nfields;
+
+  spin_lock(&lcd->frame_lock);
+  for (pos = 0; pos < lcd_region_size(&lf->win); pos++) {
+    if (cells[pos])
+      lcd_frame_set(lcd, lcd_pos_to_addr(lcd, lcd_region_cell(lcd, &lf->win, pos)), cells[pos]);
+  }
+  memcpy(lf->fields, fields, sizeof(fields));
+  lf->nfields = nfields;
+  lcd->write_seq++;
+  spin_unlock(&lcd->frame_lock);
+
+  lcd_frame_dirty(lcd);
+  return 0;
+}
+
+/*
+ * 필드 값만 받아 커널에서 포맷, 프레임에 씀.
+ * 전송은 섀도우와 다른 셀만이므로 바뀐 자릿수만 LCD로 나감
+ */
+static int lcd_layout_update(struct lcd_file* lf, const struct lcd_layout_values __user* uvals) {
+  struct hd44780* lcd = lf->lcd;
+  struct lcd_layout_values vals;
+  u8 text[LCD_LAYOUT_MAX_WIDTH];
+  u32 i;
+  int k;
+
+  if (copy_from_user(&vals, uvals, sizeof(vals)))
+    return -EFAULT;
+  if (vals.nvals > LCD_LAYOUT_MAX_FIELDS)
+    return -EINVAL;
+
+  spin_lock(&lcd->frame_lock);
+  if (!lf->nfields) {
+    spin_unlock(&lcd->frame_lock);
+    return -ENODATA;
+  }
+  for (i = 0; i < vals.nvals && i < lf->nfields; i++) {
+    const struct lcd_layout_field* f = &lf->fields[i];
+
+    lcd_layout_format(f, vals.vals[i], text);
+    for (k = 0; k < f->width; k++)
+      lcd_frame_set(lcd, lcd_pos_to_addr(lcd, lcd_region_cell(lcd, &lf->win, f->pos + k)), text[k]);
+  }
+  lcd->write_seq++;
+  spin_unlock(&lcd->frame_lock);
+
+  lcd_frame_dirty(lcd);
+  return 0;
+}
+
+/*
+ * 이 호출 전까지의 write가 LCD에 반영될 때까지 대기 (O_NONBLOCK이면 -EAGAIN).
+ * 수동 commit 모드면 마지막 COMMIT까지만 기다림
+ */
+static int lcd_fsync(struct file* file, loff_t start, loff_t end, int datasync) {
+  struct hd44780* lcd = ((struct lcd_file*)file->private_data)->lcd;
+  bool paced;
+  u64 seq;
+  int ret;
+
+  if (lcd_gone(lcd))
+    return -ENODEV;
+  spin_lock(&lcd->frame_lock);
+  seq = lcd_target_seq(lcd);
+  paced = lcd->commit_mode == LCD_COMMIT_PACED;
+  spin_unlock(&lcd->frame_lock);
+
+  if (READ_ONCE(lcd->flushed_seq) < seq) {
+    if (file->f_flags & O_NONBLOCK)
+      return -EAGAIN;
+    if (!paced) // PACED는 프레임 클럭을 기다림
+      kthread_queue_work(lcd->worker, &lcd->flush_work);
+    ret = wait_event_interruptible(lcd->flush_wq, READ_ONCE(lcd->flushed_seq) >= seq || lcd_gone(lcd));
+    if (ret)
+      return ret;
+    if (lcd_gone(lcd))
+      return -ENODEV;
   }
 
-  return to_copy;
+  spin_lock(&lcd->frame_lock);
+  ret = lcd->flush_err;
+  lcd->flush_err = 0;
+  spin_unlock(&lcd->frame_lock);
+
+  return ret;
+}
+
+/* POLLOUT: 지금까지의 write(수동 commit 모드면 COMMIT)가 모두 LCD에 반영됨 */
+static __poll_t lcd_poll(struct file* file, poll_table* wait) {
+  struct hd44780* lcd = ((struct lcd_file*)file->private_data)->lcd;
+  __poll_t mask = EPOLLIN | EPOLLRDNORM;
+
+  poll_wait(file, &lcd->flush_wq, wait);
+  if (lcd_gone(lcd))
+    return EPOLLERR | EPOLLHUP;
+
+  spin_lock(&lcd->frame_lock);
+  if (lcd->flushed_seq >= lcd_target_seq(lcd))
+    mask |= EPOLLOUT | EPOLLWRNORM;
+  spin_unlock(&lcd->frame_lock);
+
+  return mask;
+}
+
+/* 매핑(fork로 복제된 것 포함)마다 LCD 참조를 하나씩 잡음 */
+static void lcd_vm_open(struct vm_area_struct* vma) {
+  struct hd44780* lcd = vma->vm_private_data;
+
+  kref_get(&lcd->kref);
+  atomic_inc(&lcd->mmap_users);
+}
+
+static void lcd_vm_close(struct vm_area_struct* vma) {
+  struct hd44780* lcd = vma->vm_private_data;
+
+  atomic_dec(&lcd->mmap_users);
+  lcd_put(lcd);
+}
+
+static const struct vm_operations_struct lcd_vm_ops = {
+    .open = lcd_vm_open,
+    .close = lcd_vm_close,
+};
+
+/*
+ * 셀 페이지 하나만 매핑, 매핑이 생기면 주기 스캔 시작.
+ * MAP_PRIVATE는 쓰는 순간 복사본이 생겨 드라이버가 볼 수 없으므로 MAP_SHARED만 허용
+ */
+static int lcd_mmap(struct file* file, struct vm_area_struct* vma) {
+  struct hd44780* lcd = ((struct lcd_file*)file->private_data)->lcd;
+  unsigned int period = READ_ONCE(lcd->refresh_ms);
+  int ret;
+
+  if (lcd_gone(lcd))
+    return -ENODEV;
+  if (!(vma->vm_flags & VM_SHARED))
+    return -EINVAL;
+  if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > PAGE_SIZE)
+    return -EINVAL;
+
+  vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+  ret = vm_insert_page(vma, vma->vm_start, virt_to_page(lcd->mmap_buf));
+  if (ret)
+    return ret;
+
+  vma->vm_ops = &lcd_vm_ops;
+  vma->vm_private_data = lcd;
+  lcd_vm_open(vma);
+
+  if (period)
+    kthread_mod_delayed_work(lcd->worker, &lcd->refresh_work, msecs_to_jiffies(period));
+
+  return 0;
 }
 
 static long lcd_ioctl(struct file* file, unsigned int cmd, unsigned long arg) {
+  struct lcd_file* lf = file->private_data;
+  struct hd44780* lcd = lf->lcd;
+  struct lcd_region r;
+  long ret = 0;
+
+  if (lcd_gone(lcd))
+    return -ENODEV;
+
+  /* 하드웨어를 건드리지 않는 명령은 전송 중에도 바로 처리 */
+  switch (cmd) {
+  case LCD_IOCTL_COMMIT:
+    lcd_mmap_scan(lcd);
+    if (READ_ONCE(lcd->commit_mode) != LCD_COMMIT_AUTO)
+      lcd_commit(lcd);
+    return 0;
+
+  case LCD_IOCTL_SET_COMMIT_MODE: {
+    int mode = (int)arg;
+
+    if (mode < LCD_COMMIT_AUTO || mode > LCD_COMMIT_PACED)
+      return -EINVAL;
+
+    /* 모드 전환 시점의 프레임을 그대로 이어받음 */
+    spin_lock(&lcd->frame_lock);
+    if (lcd->commit_mode == LCD_COMMIT_AUTO) {
+      memcpy(lcd->committed, lcd->frame, sizeof(lcd->committed));
+      lcd->commit_seq = lcd->write_seq;
+    }
+    lcd->commit_mode = mode;
+    spin_unlock(&lcd->frame_lock);
+
+    kthread_queue_work(lcd->worker, &lcd->flush_work);
+    return 0;
+  }
+
+  case LCD_IOCTL_SET_REFRESH: {
+    int ms = (int)arg;
+
+    if (ms < 0)
+      return -EINVAL;
+    WRITE_ONCE(lcd->refresh_ms, ms);
+    if (ms && atomic_read(&lcd->mmap_users) > 0)
+      kthread_mod_delayed_work(lcd->worker, &lcd->refresh_work, msecs_to_jiffies(ms));
+    return 0;
+  }
+
+  case LCD_IOCTL_SET_CURSOR: {
+    int pos = (int)arg;
+
+    lcd_file_region(lf, &r);
+    if (pos < 0 || pos >= lcd_region_size(&r))
+      return -EINVAL;
+
+    /* 이 파일의 다음 write 위치 (lseek(SEEK_SET)과 같은 경로), 주소 명령은 실제로 쓸 때만 전송 */
+    ret = vfs_setpos(file, pos, lcd_region_size(&r));
+    return ret < 0 ? ret : 0;
+  }
+
+  case LCD_IOCTL_BATCH:
+    return lcd_batch(lf, (const struct lcd_batch __user*)arg);
+
+  case LCD_IOCTL_LAYOUT_UPDATE:
+    return lcd_layout_update(lf, (const struct lcd_layout_values __user*)arg);
+
+  case LCD_IOCTL_GET_GEOMETRY: {
+    struct lcd_geometry geo = { .cols = lcd->cols, .rows = lcd->rows };
+
+    if (copy_to_user((void __user*)arg, &geo, sizeof(geo)))
+      return -EFAULT;
+    return 0;
+  }
+  }
+
+  /* 창을 잡은 파일: 화면 전체를 건드리는 Clear/Home 대신 자기 창만 */
+  if (lf->windowed && (cmd == LCD_IOCTL_CLEAR || cmd == LCD_IOCTL_HOME)) {
+    if (cmd == LCD_IOCTL_CLEAR) {
+      lcd_file_region(lf, &r);
+      lcd_clear_region(lcd, &r);
+    }
+    file->f_pos = 0;
+    return 0;
+  }
+
+  mutex_lock(&lcd->lock);
+  if (lcd->removed) {
+    mutex_unlock(&lcd->lock);
+    return -ENODEV;
+  }
   switch (cmd) {
+  case LCD_IOCTL_SET_WINDOW: {
+    struct lcd_window win;
+
+    if (copy_from_user(&win, (void __user*)arg, sizeof(win))) {
+      ret = -EFAULT;
+      break;
+    }
+    ret = lcd_set_window(lf, &win);
+    if (!ret)
+      file->f_pos = 0;
+    break;
+  }
+
+  case LCD_IOCTL_LAYOUT_SET:
+    ret = lcd_layout_set(lf, (const struct lcd_layout __user*)arg);
+    break;
+
   case LCD_IOCTL_BACKLIGHT_ON:
-    backlight = 1;
-    lcd_expander_write(0x00);
+    lcd->backlight = 1;
+    lcd_expander_idle(lcd);
     break;
 
   case LCD_IOCTL_BACKLIGHT_OFF:
-    backlight = 0;
-    lcd_expander_write(0x00);
+    lcd->backlight = 0;
+    lcd_expander_idle(lcd);
     break;
 
   case LCD_IOCTL_DISPLAY_ON:
-    lcd_command(0x0C);
+    lcd_command(lcd, 0x0C);
     break;
 
   case LCD_IOCTL_DISPLAY_OFF:
-    lcd_command(0x08);
+    lcd_command(lcd, 0x08);
     break;
 
   case LCD_IOCTL_CLEAR:
-    lcd_command(0x01);
-    msleep(2);
+    lcd_marquee_stop_all(lcd);
+    lcd_command(lcd, 0x01);
+    lcd->entry |= 0x02; // Clear는 I/D=1로 되돌림
+    lcd_reset_shadow(lcd);
+    lcd_reset_frame(lcd);
+    file->f_pos = 0;
     break;
 
   case LCD_IOCTL_HOME:
-    lcd_command(0x02);
-    msleep(2);
+    lcd_command(lcd, 0x02);
+    lcd->ac = 0;
+    file->f_pos = 0;
+    if (lcd->marquee_hw) { // shift가 0으로 돌아갔으므로 링도 처음부터
+      lcd->marquee_hw = false;
+      lcd_marquee_update(lcd);
+    }
+    break;
+
+  case LCD_IOCTL_MARQUEE_START:
+  case LCD_IOCTL_MARQUEE_STOP:
+  case LCD_IOCTL_MARQUEE_SPEED:
+    ret = lcd_marquee_ioctl(lcd, cmd, arg);
     break;
 
   case LCD_IOCTL_ENTRY_MODE: {
     int mode;
-    if (copy_from_user(&mode, (int __user*)arg, sizeof(int)))
-      return -EFAULT;
-    if (mode >= LCD_ENTRY_LEFT && mode <= LCD_ENTRY_RIGHT_SHIFT)
-      lcd_command(mode);
+    if (copy_from_user(&mode, (int __user*)arg, sizeof(int))) {
+      ret = -EFAULT;
+      break;
+    }
+    if (mode >= LCD_ENTRY_LEFT && mode <= LCD_ENTRY_RIGHT_SHIFT) {
+      lcd_flush_frame(lcd); // 이전 방향으로 쌓인 셀을 먼저 반영
+      lcd_command(lcd, mode);
+      spin_lock(&lcd->frame_lock);
+      lcd->entry = mode;
+      spin_unlock(&lcd->frame_lock);
+    }
     else
-      return -EINVAL;
+      ret = -EINVAL;
     break;
   }
 
-  case LCD_IOCTL_SET_CURSOR:
-    int pos;
-    pos = (int)arg;
-
-    if (pos < 0 || pos > 31)
-      return -EINVAL;
-
-    /* DDRAM 주소 계산 */
-    uint8_t addr;
-    if (pos < 16)
-      addr = pos;        // 1행
-    else
-      addr = 0x40 + (pos - 16); // 2행
+  case LCD_IOCTL_GLYPH: {
+    struct lcd_glyph glyph;
 
-    lcd_command(0x80 | addr);
+    if (copy_from_user(&glyph, (void __user*)arg, sizeof(glyph))) {
+      ret = -EFAULT;
+      break;
+    }
+    ret = lcd_glyph_get(lcd, glyph.bitmap);
+    if (ret < 0)
+      break;
+    glyph.slot = ret;
+    ret = copy_to_user((void __user*)arg, &glyph, sizeof(glyph)) ? -EFAULT : 0;
     break;
+  }
 
   default:
-    return -ENOTTY;
+    ret = -ENOTTY;
   }
-  return 0;
+  mutex_unlock(&lcd->lock);
+
+  return ret;
 }
 
 static struct file_operations lcd_fops = {
     .owner = THIS_MODULE,
-    .write = lcd_write,
+    .open = lcd_open,
+    .release = lcd_release,
+    .read = lcd_read,
+    .write_iter = lcd_write_iter,
+    .llseek = lcd_llseek,
+    .fsync = lcd_fsync,
+    .poll = lcd_poll,
+    .mmap = lcd_mmap,
     .unlocked_ioctl = lcd_ioctl,
 };
 
+/* === 백엔드 === */
+#define MCP23008_IODIR  0x00
+#define MCP23008_IOCON  0x05
+#define MCP23008_OLAT   0x0A
+#define MCP23017_IODIRA 0x00
+#define MCP23017_IODIRB 0x01
+#define MCP23017_IOCON  0x0A /* BANK=0 기준 */
+#define MCP23017_OLATA  0x14
+#define MCP23017_OLATB  0x15
+#define MCP_IOCON_SEQOP 0x20 /* 주소 자동 증가 끔 */
+
+static int lcd_mcp23008_setup(struct hd44780* lcd) {
+  struct i2c_client* client = lcd->client;
+  int ret;
+
+  ret = i2c_smbus_write_byte_data(client, MCP23008_IOCON, MCP_IOCON_SEQOP);
+  if (!ret)
+    ret = i2c_smbus_write_byte_data(client, MCP23008_OLAT, 0x00);
+  if (!ret)
+    ret = i2c_smbus_write_byte_data(client, MCP23008_IODIR, 0x00); // 모두 출력
+  return ret;
+}
+
+static int lcd_mcp23017_setup(struct hd44780* lcd) {
+  struct i2c_client* client = lcd->client;
+  int ret;
+
+  /* 리셋 직후는 BANK=0이므로 IOCON은 0x0A */
+  ret = i2c_smbus_write_byte_data(client, MCP23017_IOCON, MCP_IOCON_SEQOP);
+  if (!ret)
+    ret = i2c_smbus_write_byte_data(client, MCP23017_OLATA, 0x00);
+  if (!ret)
+    ret = i2c_smbus_write_byte_data(client, MCP23017_OLATB, 0x00);
+  if (!ret)
+    ret = i2c_smbus_write_byte_data(client, MCP23017_IODIRA, 0x00);
+  if (!ret)
+    ret = i2c_smbus_write_byte_data(client, MCP23017_IODIRB, 0x00);
+  return ret;
+}
+
+static const struct lcd_backend lcd_pcf8574 = {
+    .name = "pcf8574",
+    .busy_flag = true,
+    .rs = LCD_RS, .rw = LCD_RW, .en = LCD_EN, .bl = LCD_BL,
+    .d4_shift = 4,
+};
+
+/* Adafruit I2C/SPI backpack 배치: GP1 RS, GP2 EN, GP3~GP6 D4~D7, GP7 백라이트, RW는 GND */
+static const struct lcd_backend lcd_mcp23008 = {
+    .name = "mcp23008",
+    .has_reg = true,
+    .reg = MCP23008_OLAT,
+    .rs = 0x02, .rw = 0x00, .en = 0x04, .bl = 0x80,
+    .d4_shift = 3,
+    .setup = lcd_mcp23008_setup,
+};
+
+/* GPA0~GPA7 = D0~D7, GPB0 RS, GPB1 RW, GPB2 EN, GPB3 백라이트 */
+static const struct lcd_backend lcd_mcp23017 = {
+    .name = "mcp23017",
+    .has_reg = true,
+    .reg = MCP23017_OLATA,
+    .eight_bit = true,
+    .rs = 0x01, .rw = 0x02, .en = 0x04, .bl = 0x08,
+    .setup = lcd_mcp23017_setup,
+};
+
 /* === I2C driver === */
+/* 16x2, 20x2, 20x4, 40x2 등: 각 행 시작 주소는 0x00, 0x40, cols, 0x40 + cols */
+static int lcd_parse_geometry(struct hd44780* lcd) {
+  struct device* dev = &lcd->client->dev;
+  u32 cols = 16, rows = 2;
+
+  device_property_read_u32(dev, "display-width-chars", &cols);
+  device_property_read_u32(dev, "display-height-chars", &rows);
+
+  if (cols < 1 || cols > LCD_LINE_LEN || (rows != 1 && rows != 2 && rows != 4) ||
+    (rows == 4 && cols > LCD_LINE_LEN / 2)) {
+    dev_err(dev, "unsupported geometry %ux%u\n", cols, rows);
+    return -EINVAL;
+  }
+
+  lcd->cols = cols;
+  lcd->rows = rows;
+  lcd->cells = cols * rows;
+  lcd->row_offsets[0] = 0x00;
+  lcd->row_offsets[1] = 0x40;
+  lcd->row_offsets[2] = cols;
+  lcd->row_offsets[3] = 0x40 + cols;
+
+  return 0;
+}
+
 static int lcd_probe(struct i2c_client* client) {
+  struct hd44780* lcd;
   int ret;
 
-  lcd_client = client;
+  lcd = kzalloc(sizeof(*lcd), GFP_KERNEL);
+  if (!lcd)
+    return -ENOMEM;
 
-  /* char device 등록 */
-  device_major = register_chrdev(0, DEVICE_NAME, &lcd_fops);
-  if (device_major < 0) {
-    pr_err("lcd: register_chrdev failed\n");
-    return device_major;
+  kref_init(&lcd->kref);
+  lcd->client = client;
+  lcd->timing = lcd_default_timing;
+  lcd->entry = LCD_ENTRY_RIGHT;
+  lcd->xop = LCD_OP_NONE;
+  lcd->pending_op = LCD_OP_NONE;
+  lcd->refresh_ms = refresh_ms;
+  mutex_init(&lcd->lock);
+  spin_lock_init(&lcd->frame_lock);
+  init_waitqueue_head(&lcd->flush_wq);
+  INIT_LIST_HEAD(&lcd->windows);
+  i2c_set_clientdata(client, lcd);
+
+  ret = lcd_parse_geometry(lcd);
+  if (ret)
+    goto err_free;
+
+  lcd->be = i2c_get_match_data(client);
+  if (!lcd->be)
+    lcd->be = &lcd_pcf8574;
+
+  if (i2c_check_functionality(client->adapter, I2C_FUNC_I2C))
+    lcd->xfer_mode = LCD_XFER_I2C;
+  else if (i2c_check_functionality(client->adapter, I2C_FUNC_SMBUS_WRITE_I2C_BLOCK))
+    lcd->xfer_mode = LCD_XFER_SMBUS_BLOCK;
+  else if (!lcd->be->has_reg && i2c_check_functionality(client->adapter, I2C_FUNC_SMBUS_WRITE_BYTE))
+    lcd->xfer_mode = LCD_XFER_SMBUS_BYTE;
+  else {
+    ret = -ENODEV;
+    goto err_free;
   }
 
-  lcd_class = class_create(CLASS_NAME);
-  if (IS_ERR(lcd_class)) {
-    ret = PTR_ERR(lcd_class);
-    unregister_chrdev(device_major, DEVICE_NAME);
-    return ret;
+  /* MCP는 매 전송 앞에 OLAT 레지스터 주소 */
+  lcd->xhdr = lcd->be->has_reg ? 1 : 0;
+  lcd->xbuf[0] = lcd->be->reg;
+  lcd->xlen = lcd->xhdr;
+  lcd->xctrl = 0xFF; // 첫 명령은 setup 바이트부터
+
+  if (lcd->be->setup) {
+    ret = lcd->be->setup(lcd);
+    if (ret) {
+      dev_err(&client->dev, "%s setup failed: %d\n", lcd->be->name, ret);
+      goto err_free;
+    }
   }
-  lcd_class->devnode = lcd_devnode;
 
-  lcd_device = device_create(lcd_class, NULL, MKDEV(device_major, device_minor), NULL, NODE_NAME);
-  if (IS_ERR(lcd_device)) {
-    ret = PTR_ERR(lcd_device);
-    class_destroy(lcd_class);
-    unregister_chrdev(device_major, DEVICE_NAME);
-    return ret;
+  device_property_read_u32(&client->dev, "hitachi,exec-time-us", &lcd->timing.exec_us);
+  device_property_read_u32(&client->dev, "hitachi,clear-time-us", &lcd->timing.clear_us);
+
+  lcd->id = ida_alloc_max(&lcd_ida, LCD_MAX_DEVICES - 1, GFP_KERNEL);
+  if (lcd->id < 0) {
+    ret = lcd->id;
+    goto err_free;
+  }
+
+  lcd->mmap_buf = (u8*)get_zeroed_page(GFP_KERNEL);
+  if (!lcd->mmap_buf) {
+    ret = -ENOMEM;
+    goto err_ida;
+  }
+
+  lcd->worker = kthread_create_worker(0, "hd44780-%d", lcd->id);
+  if (IS_ERR(lcd->worker)) {
+    ret = PTR_ERR(lcd->worker);
+    goto err_page;
+  }
+  kthread_init_work(&lcd->flush_work, lcd_flush_work_fn);
+  kthread_init_work(&lcd->marquee_work, lcd_marquee_work_fn);
+  hrtimer_init(&lcd->marquee_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+  lcd->marquee_timer.function = lcd_marquee_timer_fn;
+  kthread_init_delayed_work(&lcd->refresh_work, lcd_refresh_work_fn);
+
+  lcd_init_hw(lcd);
+
+  /* BF 폴링은 초기화(Function Set) 이후부터 사용 가능 */
+  if (device_property_read_bool(&client->dev, "hitachi,busy-flag")) {
+    if (lcd->xfer_mode == LCD_XFER_I2C && lcd->be->busy_flag)
+      lcd->busy_flag = true;
+    else
+      dev_warn(&client->dev, "busy-flag needs plain I2C reads on a pcf8574, using fixed delays\n");
   }
 
-  lcd_init_hw();
+  /* char device 등록: 초기화가 끝난 뒤에 노드를 만듦 */
+  mutex_lock(&lcd_table_lock);
+  lcd_table[lcd->id] = lcd;
+  mutex_unlock(&lcd_table_lock);
 
-  pr_info("lcd: probed at 0x%02x\n", client->addr);
+  lcd->cdev = cdev_alloc();
+  if (!lcd->cdev) {
+    ret = -ENOMEM;
+    goto err_table;
+  }
+  lcd->cdev->ops = &lcd_fops;
+  lcd->cdev->owner = THIS_MODULE;
+  ret = cdev_add(lcd->cdev, MKDEV(MAJOR(lcd_devt), lcd->id), 1);
+  if (ret) {
+    kobject_put(&lcd->cdev->kobj);
+    goto err_table;
+  }
+
+  lcd->dev = device_create(lcd_class, &client->dev, MKDEV(MAJOR(lcd_devt), lcd->id), lcd, NODE_NAME, lcd->id);
+  if (IS_ERR(lcd->dev)) {
+    ret = PTR_ERR(lcd->dev);
+    goto err_cdev;
+  }
+
+  lcd->debugfs = debugfs_create_dir(dev_name(lcd->dev), lcd_debugfs_root);
+  debugfs_create_file("busy_stats", 0444, lcd->debugfs, lcd, &lcd_busy_stats_fops);
+  debugfs_create_file("glyphs", 0444, lcd->debugfs, lcd, &lcd_glyphs_fops);
+
+  dev_info(&client->dev, "hd44780-%d: %dx%d via %s probed at 0x%02x\n", lcd->id, lcd->cols, lcd->rows,
+    lcd->be->name, client->addr);
   return 0;
+
+err_cdev:
+  cdev_del(lcd->cdev);
+err_table:
+  mutex_lock(&lcd_table_lock);
+  lcd_table[lcd->id] = NULL;
+  mutex_unlock(&lcd_table_lock);
+  kthread_destroy_worker(lcd->worker);
+err_page:
+  free_page((unsigned long)lcd->mmap_buf);
+err_ida:
+  ida_free(&lcd_ida, lcd->id);
+err_free:
+  kfree(lcd);
+  return ret;
 }
 
+/*
+ * 새 open을 막고 남은 전송을 끝낸 뒤 LCD를 끄고 removed 표시.
+ * 열린 파일/mmap이 남아 있으면 lcd는 마지막 참조가 풀릴 때 lcd_free()에서 해제
+ */
 static void lcd_remove(struct i2c_client* client) {
-  device_destroy(lcd_class, MKDEV(device_major, device_minor));
-  class_destroy(lcd_class);
-  unregister_chrdev(device_major, DEVICE_NAME);
+  struct hd44780* lcd = i2c_get_clientdata(client);
 
-  backlight = 0;
-  lcd_expander_write(0x00);
-  lcd_command(0x01);
-  msleep(2);
-  lcd_command(0x08);
+  mutex_lock(&lcd_table_lock);
+  lcd_table[lcd->id] = NULL;
+  mutex_unlock(&lcd_table_lock);
 
-  pr_info("lcd: removed\n");
+  debugfs_remove_recursive(lcd->debugfs);
+  device_destroy(lcd_class, MKDEV(MAJOR(lcd_devt), lcd->id));
+  cdev_del(lcd->cdev);
+  kthread_cancel_delayed_work_sync(&lcd->refresh_work);
+
+  mutex_lock(&lcd->lock);
+  lcd_marquee_stop_all(lcd);
+  mutex_unlock(&lcd->lock);
+  kthread_cancel_work_sync(&lcd->marquee_work);
+  kthread_flush_worker(lcd->worker); // 남은 flush 처리
+
+  /* 이후 worker와 파일 연산은 removed를 보고 I2C를 건드리지 않음 */
+  mutex_lock(&lcd->lock);
+  lcd->backlight = 0;
+  lcd_expander_idle(lcd);
+  lcd_command(lcd, 0x01);
+  lcd_command(lcd, 0x08);
+  WRITE_ONCE(lcd->removed, true);
+  mutex_unlock(&lcd->lock);
+  wake_up_interruptible(&lcd->flush_wq); // fsync 대기자는 -ENODEV
+
+  ida_free(&lcd_ida, lcd->id);
+  dev_info(&client->dev, "hd44780-%d: removed\n", lcd->id);
+  lcd_put(lcd);
 }
 
 static const struct of_device_id lcd_of_match[] = {
-    {.compatible = "hitachi,hd44780" },
+    {.compatible = "hitachi,hd44780", .data = &lcd_pcf8574 },
+    {.compatible = "hitachi,hd44780-mcp23008", .data = &lcd_mcp23008 },
+    {.compatible = "hitachi,hd44780-mcp23017", .data = &lcd_mcp23017 },
     { }
 };
 MODULE_DEVICE_TABLE(of, lcd_of_match);
 
 static const struct i2c_device_id lcd_id[] = {
-    { "i2c_lcd", 0 },
+    { "i2c_lcd", (kernel_ulong_t)&lcd_pcf8574 },
+    { "i2c_lcd_mcp23008", (kernel_ulong_t)&lcd_mcp23008 },
+    { "i2c_lcd_mcp23017", (kernel_ulong_t)&lcd_mcp23017 },
     { }
 };
 MODULE_DEVICE_TABLE(i2c, lcd_id);
@@ -244,5 +2330,45 @@ static struct i2c_driver lcd_driver = {
     .id_table = lcd_id,
 };
 
-/* init/exit 대신 매크로 하나로 */
-module_i2c_driver(lcd_driver);
\ No newline at end of file
+/* 여러 LCD가 major 번호와 class를 공유하므로 드라이버 등록 전에 한 번만 생성 */
+static int __init lcd_module_init(void) {
+  int ret;
+
+  ret = alloc_chrdev_region(&lcd_devt, 0, LCD_MAX_DEVICES, DEVICE_NAME);
+  if (ret < 0) {
+    pr_err("lcd: alloc_chrdev_region failed\n");
+    return ret;
+  }
+
+  lcd_class = class_create(CLASS_NAME);
+  if (IS_ERR(lcd_class)) {
+    ret = PTR_ERR(lcd_class);
+    goto err_region;
+  }
+  lcd_class->devnode = lcd_devnode;
+
+  lcd_debugfs_root = debugfs_create_dir(DEVICE_NAME, NULL);
+
+  ret = i2c_add_driver(&lcd_driver);
+  if (ret)
+    goto err_class;
+
+  return 0;
+
+err_class:
+  debugfs_remove_recursive(lcd_debugfs_root);
+  class_destroy(lcd_class);
+err_region:
+  unregister_chrdev_region(lcd_devt, LCD_MAX_DEVICES);
+  return ret;
+}
+
+static void __exit lcd_module_exit(void) {
+  i2c_del_driver(&lcd_driver);
+  debugfs_remove_recursive(lcd_debugfs_root);
+  class_destroy(lcd_class);
+  unregister_chrdev_region(lcd_devt, LCD_MAX_DEVICES);
+}
+
+module_init(lcd_module_init);
+module_exit(lcd_module_exit);
@@ -0,0 +1,425 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/i2c.h>
+#include <linux/delay.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+/*
+ * PCF8574 + HD44780 소프트웨어 모델.
+ * 가상 I2C 어댑터를 만들고 그 위에 "i2c_lcd" 클라이언트를 등록하면 hd44780 드라이버가
+ * 실제 하드웨어 대신 이 모델에 붙는다. PCF8574 포트 바이트 스트림에서 EN 하강 에지마다
+ * 니블을 래치해 명령/데이터를 해석하고 DDRAM/CGRAM/AC, 모델링한 버스 시간,
+ * 실행 시간 위반을 기록한다 (debugfs hd44780_emul/stats, display).
+ */
+
+#define EMUL_RS  0x01
+#define EMUL_RW  0x02
+#define EMUL_EN  0x04
+#define EMUL_BL  0x08
+
+#define EMUL_DDRAM_SIZE  0x80
+#define EMUL_CGRAM_SIZE  0x40
+#define EMUL_LINE_LEN    0x28
+
+/* 데이터시트 실행 시간 (fosc 270kHz) */
+#define EMUL_EXEC_NS   37000
+#define EMUL_CLEAR_NS  1520000
+
+static unsigned short addr = 0x27;
+module_param(addr, ushort, 0444);
+MODULE_PARM_DESC(addr, "emulated PCF8574 address (default 0x27)");
+
+static unsigned int bus_khz = 100;
+module_param(bus_khz, uint, 0444);
+MODULE_PARM_DESC(bus_khz, "modelled I2C clock in kHz (default 100)");
+
+static bool realtime = true;
+module_param(realtime, bool, 0444);
+MODULE_PARM_DESC(realtime, "sleep for the modelled bus time of each transfer and check execution times (default Y)");
+
+static unsigned int cols = 16;
+module_param(cols, uint, 0444);
+MODULE_PARM_DESC(cols, "columns shown in debugfs display (default 16)");
+
+static unsigned int rows = 2;
+module_param(rows, uint, 0444);
+MODULE_PARM_DESC(rows, "rows shown in debugfs display (default 2)");
+
+struct emul_stats {
+  u64 xfers;      /* i2c_transfer 호출 */
+  u64 msgs;
+  u64 bytes;      /* 주소 바이트 제외 */
+  u64 bus_ns;     /* 모델링한 버스 시간 */
+  u64 cmds;
+  u64 data;
+  u64 clears;     /* Clear / Return Home */
+  u64 bf_reads;   /* RW=1 EN 펄스 */
+  u64 violations; /* 실행 중에 들어온 명령/데이터 */
+  u64 max_early_ns;
+};
+
+struct hd44780_emul {
+  struct i2c_adapter adap;
+  struct i2c_client* client;
+  struct dentry* debugfs;
+  struct mutex lock;
+
+  /* PCF8574 */
+  u8 port;
+
+  /* HD44780 */
+  bool four_bit;
+  bool nibble_lo;   /* 4비트 모드에서 다음 니블이 하위 */
+  u8 nibble_hi;
+  u64 nibble_t;     /* 상위 니블 래치 시각, 실행 중에 들어왔는지 검사용 (실행은 하위 니블부터) */
+  bool read_lo;     /* 4비트 읽기 니블 순서 */
+  int init_step;    /* 8비트 Function Set 횟수 (초기화 대기 시간) */
+  u8 ddram[EMUL_DDRAM_SIZE];
+  u8 cgram[EMUL_CGRAM_SIZE];
+  u8 ac;
+  bool ac_cgram;
+  bool inc;         /* I/D */
+  bool entry_shift; /* S */
+  bool display_on;
+  int shift;        /* display shift (0 ~ 39) */
+  u64 busy_until;   /* 모델 시각(ns) */
+
+  struct emul_stats stats;
+};
+
+static struct hd44780_emul* emul;
+
+/* 7비트 주소 + ACK, START/STOP 포함 대략 1바이트 + 1비트 */
+static u64 emul_byte_ns(void) {
+  return 9ULL * 1000000 / bus_khz;
+}
+
+static u64 emul_msg_overhead_ns(void) {
+  return 10ULL * 1000000 / bus_khz;
+}
+
+static u8 emul_ddram_next(u8 a, bool inc) {
+  if (inc)
+    return a == 0x27 ? 0x40 : a == 0x67 ? 0x00 : a + 1;
+  return a == 0x00 ? 0x67 : a == 0x40 ? 0x27 : a - 1;
+}
+
+static void emul_display_shift(struct hd44780_emul* e, bool left) {
+  e->shift = (e->shift + (left ? 1 : EMUL_LINE_LEN - 1)) % EMUL_LINE_LEN;
+}
+
+/* 명령 하나 실행, 실행 시간(ns) 반환 */
+static u64 emul_command(struct hd44780_emul* e, u8 cmd) {
+  e->stats.cmds++;
+
+  if (cmd & 0x80) {
+    e->ac = cmd & 0x7F;
+    e->ac_cgram = false;
+  }
+  else if (cmd & 0x40) {
+    e->ac = cmd & 0x3F;
+    e->ac_cgram = true;
+  }
+  else if (cmd & 0x20) {
+    bool was_8bit = !e->four_bit;
+
+    e->four_bit = !(cmd & 0x10);
+    e->nibble_lo = false;
+    /* 전원 투입 후 8비트 Function Set: 4.1ms, 100us, 이후 보통 */
+    if (was_8bit && e->init_step < 2)
+      return e->init_step++ == 0 ? 4100000 : 100000;
+  }
+  else if (cmd & 0x10) {
+    if (cmd & 0x08)
+      emul_display_shift(e, !(cmd & 0x04));
+    else if (!e->ac_cgram)
+      e->ac = emul_ddram_next(e->ac, cmd & 0x04);
+    else
+      e->ac = (e->ac + ((cmd & 0x04) ? 1 : -1)) & 0x3F;
+  }
+  else if (cmd & 0x08) {
+    e->display_on = cmd & 0x04;
+  }
+  else if (cmd & 0x04) {
+    e->inc = cmd & 0x02;
+    e->entry_shift = cmd & 0x01;
+  }
+  else if (cmd & 0x02) {
+    e->stats.clears++;
+    e->ac = 0;
+    e->ac_cgram = false;
+    e->shift = 0;
+    return EMUL_CLEAR_NS;
+  }
+  else if (cmd & 0x01) {
+    e->stats.clears++;
+    memset(e->ddram, ' ', sizeof(e->ddram));
+    e->ac = 0;
+    e->ac_cgram = false;
+    e->inc = true;
+    e->shift = 0;
+    return EMUL_CLEAR_NS;
+  }
+  return EMUL_EXEC_NS;
+}
+
+static u64 emul_data(struct hd44780_emul* e, u8 c) {
+  e->stats.data++;
+
+  if (e->ac_cgram) {
+    e->cgram[e->ac] = c & 0x1F;
+    e->ac = (e->ac + (e->inc ? 1 : -1)) & 0x3F;
+    return EMUL_EXEC_NS;
+  }
+
+  e->ddram[e->ac] = c;
+  e->ac = emul_ddram_next(e->ac, e->inc);
+  if (e->entry_shift)
+    emul_display_shift(e, e->inc);
+  return EMUL_EXEC_NS;
+}
+
+/*
+ * 완성된 8비트 명령/데이터, first = 첫 니블의 EN 하강 시각, t = 마지막 니블의 EN 하강 시각(모델)
+ * 첫 니블부터 실행 중이면 위반, 실행은 마지막 니블이 래치된 뒤에 시작
+ */
+static void emul_execute(struct hd44780_emul* e, u8 value, bool rs, u64 first, u64 t) {
+  if (realtime && first < e->busy_until) {
+    e->stats.violations++;
+    e->stats.max_early_ns = max(e->stats.max_early_ns, e->busy_until - first);
+  }
+  e->busy_until = t + (rs ? emul_data(e, value) : emul_command(e, value));
+}
+
+/* LCD가 읽기(RW=1, EN=1) 동안 D7~D4에 내보내는 니블: BF + AC */
+static u8 emul_read_nibble(struct hd44780_emul* e, u64 t) {
+  u8 bf_ac = ((realtime && t < e->busy_until) ? 0x80 : 0x00) | (e->ac & 0x7F);
+
+  return e->read_lo ? (bf_ac & 0x0F) : (bf_ac >> 4);
+}
+
+/* PCF8574 포트에 바이트 하나가 써짐, EN 하강 에지에서 그 전 포트 값의 D7~D4를 래치 */
+static void emul_port_write(struct hd44780_emul* e, u8 val, u64 t) {
+  u8 prev = e->port;
+  u8 nibble = prev >> 4;
+
+  e->port = val;
+  if (!(prev & EMUL_EN) || (val & EMUL_EN))
+    return;
+
+  if (prev & EMUL_RW) {
+    e->stats.bf_reads++;
+    if (e->four_bit)
+      e->read_lo = !e->read_lo;
+    return;
+  }
+
+  if (!e->four_bit) {
+    /* 8비트 모드 (초기화 중): D3~D0은 연결되지 않아 0 */
+    e->read_lo = false;
+    emul_execute(e, nibble << 4, prev & EMUL_RS, t, t);
+    return;
+  }
+
+  if (!e->nibble_lo) {
+    e->nibble_hi = nibble;
+    e->nibble_t = t;
+    e->nibble_lo = true;
+    return;
+  }
+  e->nibble_lo = false;
+  e->read_lo = false;
+  emul_execute(e, (e->nibble_hi << 4) | nibble, prev & EMUL_RS, e->nibble_t, t);
+}
+
+/* 읽기: 출력이 1인 핀만 입력으로 동작 (준양방향), 읽기 사이클 중에는 LCD가 D7~D4를 구동 */
+static u8 emul_port_read(struct hd44780_emul* e, u64 t) {
+  u8 val = e->port;
+
+  if ((val & EMUL_RW) && (val & EMUL_EN))
+    val &= (emul_read_nibble(e, t) << 4) | 0x0F;
+  return val;
+}
+
+static int emul_xfer(struct i2c_adapter* adap, struct i2c_msg* msgs, int num) {
+  struct hd44780_emul* e = i2c_get_adapdata(adap);
+  u64 start = ktime_get_ns();
+  u64 t = start;
+  int i, j;
+
+  for (i = 0; i < num; i++) {
+    if (msgs[i].addr != addr)
+      return -ENXIO;
+  }
+
+  mutex_lock(&e->lock);
+  e->stats.xfers++;
+  for (i = 0; i < num; i++) {
+    t += emul_msg_overhead_ns();
+    e->stats.msgs++;
+    e->stats.bytes += msgs[i].len;
+
+    for (j = 0; j < msgs[i].len; j++) {
+      t += emul_byte_ns();
+      if (msgs[i].flags & I2C_M_RD)
+        msgs[i].buf[j] = emul_port_read(e, t);
+      else
+        emul_port_write(e, msgs[i].buf[j], t);
+    }
+  }
+  e->stats.bus_ns += t - start;
+  mutex_unlock(&e->lock);
+
+  /* 버스가 실제로 걸리는 시간만큼 대기: 드라이버의 실행 시간 대기가 모델 시각과 맞게 */
+  if (realtime) {
+    s64 ns = t - ktime_get_ns();
+
+    if (ns > 0)
+      fsleep(DIV_ROUND_UP(ns, 1000));
+  }
+
+  return num;
+}
+
+static u32 emul_func(struct i2c_adapter* adap) {
+  return I2C_FUNC_I2C | I2C_FUNC_SMBUS_EMUL;
+}
+
+static const struct i2c_algorithm emul_algo = {
+    .master_xfer = emul_xfer,
+    .functionality = emul_func,
+};
+
+/* === debugfs === */
+static int emul_stats_show(struct seq_file* m, void* v) {
+  struct hd44780_emul* e = m->private;
+  struct emul_stats s;
+
+  mutex_lock(&e->lock);
+  s = e->stats;
+  mutex_unlock(&e->lock);
+
+  seq_printf(m, "xfers: %llu\n", s.xfers);
+  seq_printf(m, "msgs: %llu\n", s.msgs);
+  seq_printf(m, "bytes: %llu\n", s.bytes);
+  seq_printf(m, "bus_us: %llu\n", div_u64(s.bus_ns, 1000));
+  seq_printf(m, "cmds: %llu\n", s.cmds);
+  seq_printf(m, "data: %llu\n", s.data);
+  seq_printf(m, "clears: %llu\n", s.clears);
+  seq_printf(m, "bf_reads: %llu\n", s.bf_reads);
+  seq_printf(m, "violations: %llu\n", s.violations);
+  seq_printf(m, "max_early_us: %llu\n", div_u64(s.max_early_ns, 1000));
+  return 0;
+}
+
+static int emul_stats_open(struct inode* inode, struct file* file) {
+  return single_open(file, emul_stats_show, inode->i_private);
+}
+
+/* 아무 값이나 쓰면 통계 초기화 */
+static ssize_t emul_stats_write(struct file* file, const char __user* buf, size_t len, loff_t* off) {
+  struct hd44780_emul* e = ((struct seq_file*)file->private_data)->private;
+
+  mutex_lock(&e->lock);
+  memset(&e->stats, 0, sizeof(e->stats));
+  mutex_unlock(&e->lock);
+  return len;
+}
+
+static const struct file_operations emul_stats_fops = {
+    .owner = THIS_MODULE,
+    .open = emul_stats_open,
+    .read = seq_read,
+    .write = emul_stats_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+/* 보이는 화면 (display shift 반영), 표시할 수 없는 문자는 '.' */
+static int emul_display_show(struct seq_file* m, void* v) {
+  static const u8 line_base[4] = { 0x00, 0x40, 0x00, 0x40 };
+  struct hd44780_emul* e = m->private;
+  unsigned int r, c;
+
+  mutex_lock(&e->lock);
+  seq_printf(m, "ac: 0x%02x%s  shift: %d  display: %s  mode: %s\n", e->ac, e->ac_cgram ? " (cgram)" : "",
+    e->shift, e->display_on ? "on" : "off", e->four_bit ? "4-bit" : "8-bit");
+  for (r = 0; r < min(rows, 4U); r++) {
+    seq_putc(m, '[');
+    for (c = 0; c < min(cols, (unsigned int)EMUL_LINE_LEN); c++) {
+      unsigned int off = (r >= 2 ? cols : 0) + c + e->shift;
+      u8 ch = e->ddram[line_base[r] + off % EMUL_LINE_LEN];
+
+      seq_putc(m, (ch >= 0x20 && ch < 0x7F) ? ch : '.');
+    }
+    seq_puts(m, "]\n");
+  }
+  mutex_unlock(&e->lock);
+  return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(emul_display);
+
+static int __init hd44780_emul_init(void) {
+  struct i2c_board_info info = { I2C_BOARD_INFO("i2c_lcd", 0) };
+  int ret;
+
+  if (bus_khz == 0)
+    return -EINVAL;
+
+  emul = kzalloc(sizeof(*emul), GFP_KERNEL);
+  if (!emul)
+    return -ENOMEM;
+
+  mutex_init(&emul->lock);
+  emul->port = 0xFF; // PCF8574 전원 투입 시 모든 핀 1
+  emul->inc = true;
+  memset(emul->ddram, ' ', sizeof(emul->ddram));
+
+  emul->adap.owner = THIS_MODULE;
+  emul->adap.algo = &emul_algo;
+  strscpy(emul->adap.name, "hd44780-emul", sizeof(emul->adap.name));
+  i2c_set_adapdata(&emul->adap, emul);
+
+  ret = i2c_add_adapter(&emul->adap);
+  if (ret) {
+    kfree(emul);
+    return ret;
+  }
+
+  emul->debugfs = debugfs_create_dir("hd44780_emul", NULL);
+  debugfs_create_file("stats", 0644, emul->debugfs, emul, &emul_stats_fops);
+  debugfs_create_file("display", 0444, emul->debugfs, emul, &emul_display_fops);
+
+  /* hd44780 모듈이 로드돼 있으면 바로 probe, 아니면 로드될 때 */
+  info.addr = addr;
+  emul->client = i2c_new_client_device(&emul->adap, &info);
+  if (IS_ERR(emul->client)) {
+    ret = PTR_ERR(emul->client);
+    debugfs_remove_recursive(emul->debugfs);
+    i2c_del_adapter(&emul->adap);
+    kfree(emul);
+    return ret;
+  }
+
+  pr_info("hd44780_emul: i2c-%d, pcf8574 @0x%02x, %u kHz\n", emul->adap.nr, addr, bus_khz);
+  return 0;
+}
+
+static void __exit hd44780_emul_exit(void) {
+  i2c_unregister_device(emul->client);
+  debugfs_remove_recursive(emul->debugfs);
+  i2c_del_adapter(&emul->adap);
+  kfree(emul);
+}
+
+module_init(hd44780_emul_init);
+module_exit(hd44780_emul_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Jinhyeok Jeon");
+MODULE_DESCRIPTION("PCF8574 + HD44780 emulator on a virtual I2C adapter");
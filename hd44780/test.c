@@ -3,19 +3,384 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <dirent.h>
 #include "hd44780.h"
 
-int main(void) {
+static double elapsed_us(struct timespec* a, struct timespec* b) {
+  return (b->tv_sec - a->tv_sec) * 1e6 + (b->tv_nsec - a->tv_nsec) / 1e3;
+}
+
+static double cpu_us(struct rusage* a, struct rusage* b) {
+  return (b->ru_utime.tv_sec - a->ru_utime.tv_sec) * 1e6 + (b->ru_utime.tv_usec - a->ru_utime.tv_usec)
+    + (b->ru_stime.tv_sec - a->ru_stime.tv_sec) * 1e6 + (b->ru_stime.tv_usec - a->ru_stime.tv_usec);
+}
+
+/*
+ * 장치의 전송 kthread("hd44780-N")가 지금까지 쓴 CPU 시간 (us), 못 찾으면 -1.
+ * write는 프레임만 갱신하고 I2C 전송과 대기는 이 스레드에서 일어나므로
+ * 드라이버 비용은 getrusage(RUSAGE_SELF)가 아니라 여기에 잡힘 (/proc/<pid>/stat의 utime + stime, 틱 단위)
+ */
+static double worker_cpu_us(const char* path) {
+  const char* name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  char want[64], file[300], buf[512];
+  size_t wlen = snprintf(want, sizeof(want), "(%s)", name);
+  struct dirent* de;
+  double us = -1;
+  DIR* dir = opendir("/proc");
+
+  if (!dir)
+    return -1;
+  while (us < 0 && (de = readdir(dir))) {
+    unsigned long utime, stime;
+    char *l, *r;
+    FILE* fp;
+
+    if (de->d_name[0] < '0' || de->d_name[0] > '9')
+      continue;
+    snprintf(file, sizeof(file), "/proc/%s/stat", de->d_name);
+    fp = fopen(file, "r");
+    if (!fp)
+      continue;
+    /* "pid (comm) state ...", utime/stime는 14/15번째 필드 */
+    if (fgets(buf, sizeof(buf), fp) && (l = strchr(buf, '(')) && (r = strrchr(buf, ')')) &&
+      (size_t)(r - l + 1) == wlen && !strncmp(l, want, wlen) &&
+      sscanf(r + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) == 2)
+      us = (double)(utime + stime) * 1e6 / sysconf(_SC_CLK_TCK);
+    fclose(fp);
+  }
+  closedir(dir);
+  return us;
+}
+
+/*
+ * 화면 크기(셀 수)만큼 모두 바뀌는 갱신을 반복해 1회당 wall/CPU 시간 측정.
+ * CPU 시간은 이 프로세스(user+sys)와 전송 kthread를 따로 출력.
+ * commit=1이면 수동 commit 모드: 행을 모두 쓴 뒤 COMMIT으로 한 번의 버스트 전송
+ */
+static int bench(int fd, const char* path, int count, int commit) {
+  static const char pattern[2][41] = {
+    "ABCDEFGHIJKLMNOPQRSTabcdefghijklmnopqrst",
+    "0123456789!@#$%^&*()9876543210)(*&^%$#@",
+  };
+  struct lcd_geometry geo;
+  struct timespec t0, t1;
+  struct rusage r0, r1;
+  double w0, w1;
+
+  if (count <= 0)
+    count = 100;
+
+  if (ioctl(fd, LCD_IOCTL_GET_GEOMETRY, &geo) < 0) {
+    perror("ioctl LCD_IOCTL_GET_GEOMETRY");
+    return -1;
+  }
+
+  if (ioctl(fd, LCD_IOCTL_CLEAR) < 0) {
+    perror("ioctl LCD_IOCTL_CLEAR");
+    return -1;
+  }
+
+  if (ioctl(fd, LCD_IOCTL_SET_COMMIT_MODE, commit ? LCD_COMMIT_MANUAL : LCD_COMMIT_AUTO) < 0) {
+    perror("ioctl LCD_IOCTL_SET_COMMIT_MODE");
+    return -1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  getrusage(RUSAGE_SELF, &r0);
+  w0 = worker_cpu_us(path);
+  for (int i = 0; i < count; ++i) {
+    /* 행마다 서로 다른 내용, write는 프레임만 갱신하므로 fsync로 LCD 반영까지 대기 */
+    for (int row = 0; row < geo.rows; ++row) {
+      if (ioctl(fd, LCD_IOCTL_SET_CURSOR, row * geo.cols) < 0 ||
+        write(fd, pattern[(i + row) % 2] + row, geo.cols) < 0) {
+        perror("write");
+        return -1;
+      }
+    }
+    if ((commit && ioctl(fd, LCD_IOCTL_COMMIT) < 0) || fsync(fd) < 0) {
+      perror("commit");
+      return -1;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  getrusage(RUSAGE_SELF, &r1);
+  w1 = worker_cpu_us(path);
+
+  ioctl(fd, LCD_IOCTL_SET_COMMIT_MODE, LCD_COMMIT_AUTO);
+
+  printf("display             : %dx%d (%s)\n", geo.cols, geo.rows, commit ? "manual commit" : "auto");
+  printf("full-screen updates : %d\n", count);
+  printf("wall time / update  : %.1f us\n", elapsed_us(&t0, &t1) / count);
+  printf("cpu time / update   : %.1f us (this process)\n", cpu_us(&r0, &r1) / count);
+  if (w0 >= 0 && w1 >= 0)
+    printf("                      %.1f us (worker thread)\n", (w1 - w0) / count);
+  else
+    printf("                      worker thread not found\n");
+  return 0;
+}
+
+/* === 에뮬레이터(hd44780_emul) 비용 측정 === */
+#define EMUL_STATS_PATH  "/sys/kernel/debug/hd44780_emul/stats"
+
+struct emul_cost {
+  long long xfers;
+  long long bytes;
+  long long bus_us;
+  long long violations;
+};
+
+static int emul_read(struct emul_cost* c) {
+  char line[64];
+  long long v;
+  FILE* fp = fopen(EMUL_STATS_PATH, "r");
+
+  if (!fp) {
+    perror(EMUL_STATS_PATH);
+    return -1;
+  }
+  memset(c, 0, sizeof(*c));
+  while (fgets(line, sizeof(line), fp)) {
+    if (sscanf(line, "xfers: %lld", &v) == 1) c->xfers = v;
+    else if (sscanf(line, "bytes: %lld", &v) == 1) c->bytes = v;
+    else if (sscanf(line, "bus_us: %lld", &v) == 1) c->bus_us = v;
+    else if (sscanf(line, "violations: %lld", &v) == 1) c->violations = v;
+  }
+  fclose(fp);
+  return 0;
+}
+
+static void emul_report(const char* name, struct emul_cost* a, struct emul_cost* b, int count) {
+  printf("%-14s: %7.1f xfers  %8.1f bytes  %9.1f us bus  (violations %lld)\n", name,
+    (double)(b->xfers - a->xfers) / count, (double)(b->bytes - a->bytes) / count,
+    (double)(b->bus_us - a->bus_us) / count, b->violations - a->violations);
+}
+
+/* 전체 화면 / 숫자 한 칸 / Clear 1회당 I2C 트랜잭션, 바이트, 모델링한 버스 시간 */
+static int cost(int fd, int count) {
+  static const char pattern[2][41] = {
+    "ABCDEFGHIJKLMNOPQRSTabcdefghijklmnopqrst",
+    "0123456789!@#$%^&*()9876543210)(*&^%$#@",
+  };
+  struct emul_cost c0, c1;
+  struct lcd_geometry geo;
+
+  if (count <= 0)
+    count = 20;
+
+  if (ioctl(fd, LCD_IOCTL_GET_GEOMETRY, &geo) < 0 || ioctl(fd, LCD_IOCTL_CLEAR) < 0) {
+    perror("ioctl");
+    return -1;
+  }
+
+  /* 전체 화면: 모든 셀이 바뀌는 갱신 */
+  if (fsync(fd) < 0 || emul_read(&c0) < 0)
+    return -1;
+  for (int i = 0; i < count; ++i) {
+    for (int row = 0; row < geo.rows; ++row)
+      pwrite(fd, pattern[(i + row) % 2] + row, geo.cols, row * geo.cols);
+    fsync(fd);
+  }
+  if (emul_read(&c1) < 0)
+    return -1;
+  emul_report("full frame", &c0, &c1, count);
+
+  /* 숫자 한 칸 */
+  c0 = c1;
+  for (int i = 0; i < count; ++i) {
+    char digit = '0' + i % 10;
+    pwrite(fd, &digit, 1, geo.cols - 1);
+    fsync(fd);
+  }
+  if (emul_read(&c1) < 0)
+    return -1;
+  emul_report("single digit", &c0, &c1, count);
+
+  /* Clear */
+  c0 = c1;
+  for (int i = 0; i < count; ++i) {
+    ioctl(fd, LCD_IOCTL_CLEAR);
+    fsync(fd);
+  }
+  if (emul_read(&c1) < 0)
+    return -1;
+  emul_report("clear", &c0, &c1, count);
+  return 0;
+}
+
+/* CGRAM 글리프로 막대 그래프 애니메이션: 글리프 5개는 처음 한 번만 CGRAM에 올라감 */
+static int bars(int fd, int count) {
+  struct lcd_glyph glyph;
+  struct lcd_geometry geo;
+  char line[41];
+  char level[6];
+
+  if (count <= 0)
+    count = 100;
+
+  if (ioctl(fd, LCD_IOCTL_GET_GEOMETRY, &geo) < 0) {
+    perror("ioctl LCD_IOCTL_GET_GEOMETRY");
+    return -1;
+  }
+
+  level[0] = ' ';
+  for (int i = 0; i < count; ++i) {
+    /* 1~5칸 채워진 막대, 이미 올라간 비트맵이면 같은 슬롯을 돌려받음 */
+    for (int w = 1; w <= 5; ++w) {
+      memset(glyph.bitmap, (0x1F << (5 - w)) & 0x1F, sizeof(glyph.bitmap));
+      if (ioctl(fd, LCD_IOCTL_GLYPH, &glyph) < 0) {
+        perror("ioctl LCD_IOCTL_GLYPH");
+        return -1;
+      }
+      level[w] = glyph.slot + 8; // NUL 대신 같은 글리프인 8~15 사용
+    }
+
+    int fill = i % (geo.cols * 5 + 1);
+    for (int c = 0; c < geo.cols; ++c) {
+      int w = fill - c * 5;
+      line[c] = level[w < 0 ? 0 : w > 5 ? 5 : w];
+    }
+
+    if (ioctl(fd, LCD_IOCTL_SET_CURSOR, 0) < 0 || write(fd, line, geo.cols) < 0 || fsync(fd) < 0) {
+      perror("write");
+      return -1;
+    }
+    usleep(20000);
+  }
+
+  puts("see /sys/kernel/debug/hd44780/hd44780-0/glyphs for cache hits/uploads");
+  return 0;
+}
+
+static int marquee_start(int fd, int row, const char* text, int period_ms) {
+  struct lcd_marquee mq = { .row = row, .period_ms = period_ms, .dir = LCD_MARQUEE_LEFT };
+
+  mq.len = strlen(text) > sizeof(mq.text) ? sizeof(mq.text) : strlen(text);
+  memcpy(mq.text, text, mq.len);
+  if (ioctl(fd, LCD_IOCTL_MARQUEE_START, &mq) < 0) {
+    perror("ioctl LCD_IOCTL_MARQUEE_START");
+    return -1;
+  }
+  return 0;
+}
+
+/* 모든 행이 같은 주기 → 하드웨어 shift, 한 행의 속도를 바꾸면 → 소프트웨어 갱신 */
+static int marquee(int fd) {
+  struct lcd_marquee_speed speed = { .row = 1, .period_ms = 150 };
+
+  if (marquee_start(fd, 0, "*** CO2 HIGH - OPEN THE WINDOW ***", 300) < 0 ||
+    marquee_start(fd, 1, "device id: rpi3-env-monitor-01", 300) < 0)
+    return -1;
+
+  puts("hardware display shift for 10 seconds . . .");
+  sleep(10);
+
+  if (ioctl(fd, LCD_IOCTL_MARQUEE_SPEED, &speed) < 0) {
+    perror("ioctl LCD_IOCTL_MARQUEE_SPEED");
+    return -1;
+  }
+  puts("different speeds (software redraw) for 10 seconds . . .");
+  sleep(10);
+
+  if (ioctl(fd, LCD_IOCTL_MARQUEE_STOP, -1) < 0) {
+    perror("ioctl LCD_IOCTL_MARQUEE_STOP");
+    return -1;
+  }
+  return 0;
+}
+
+/* 프로세스마다 한 행을 창으로 잡고 동시에 갱신, 드라이버가 한 프레임으로 합쳐 전송 */
+static int windows(const char* path, int count) {
+  struct lcd_geometry geo;
+  int nproc;
+  int fd;
+
+  if (count <= 0)
+    count = 100;
+
+  fd = open(path, O_RDWR);
+  if (fd < 0 || ioctl(fd, LCD_IOCTL_GET_GEOMETRY, &geo) < 0) {
+    perror("open");
+    return -1;
+  }
+  close(fd);
+
+  nproc = geo.rows < 2 ? geo.rows : 2;
+  for (int p = 0; p < nproc; ++p) {
+    if (fork() != 0)
+      continue;
+
+    struct lcd_window win = { .row = p, .col = 0, .width = geo.cols, .height = 1 };
+    char line[41];
+
+    fd = open(path, O_WRONLY);
+    if (fd < 0 || ioctl(fd, LCD_IOCTL_SET_WINDOW, &win) < 0 || ioctl(fd, LCD_IOCTL_CLEAR) < 0) {
+      perror("window");
+      exit(1);
+    }
+    for (int i = 0; i < count; ++i) {
+      int len = snprintf(line, sizeof(line), "client%d: %d", p, i);
+      if (pwrite(fd, line, len, 0) < 0) { // 위치 0 = 창의 첫 셀
+        perror("pwrite");
+        exit(1);
+      }
+      usleep(50000);
+    }
+    close(fd);
+    exit(0);
+  }
+
+  for (int p = 0; p < nproc; ++p)
+    wait(NULL);
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
   int fd;
   char buf[100];
+  const char* path = "/dev/hd44780-0";
+
+  /* ./test [bench|bench-commit|bars|windows|cost [횟수] | marquee] [장치], 예: ./test bench 100 /dev/hd44780-1 */
+  if (argc > 1 && argv[argc - 1][0] == '/')
+    path = argv[--argc];
+
+  if (argc > 1 && !strcmp(argv[1], "windows"))
+    return windows(path, argc > 2 ? atoi(argv[2]) : 100) < 0 ? 1 : 0;
 
-  fd = open("/dev/hd44780", O_WRONLY);
+  fd = open(path, O_RDWR);
   if (fd < 0) {
     perror("open");
     exit(1);
   }
 
+  if (argc > 1 && !strncmp(argv[1], "bench", 5)) {
+    int ret = bench(fd, path, argc > 2 ? atoi(argv[2]) : 100, !strcmp(argv[1], "bench-commit"));
+    close(fd);
+    return ret < 0 ? 1 : 0;
+  }
+
+  if (argc > 1 && !strcmp(argv[1], "cost")) {
+    int ret = cost(fd, argc > 2 ? atoi(argv[2]) : 20);
+    close(fd);
+    return ret < 0 ? 1 : 0;
+  }
+
+  if (argc > 1 && !strcmp(argv[1], "marquee")) {
+    int ret = marquee(fd);
+    close(fd);
+    return ret < 0 ? 1 : 0;
+  }
+
+  if (argc > 1 && !strcmp(argv[1], "bars")) {
+    int ret = bars(fd, argc > 2 ? atoi(argv[2]) : 100);
+    close(fd);
+    return ret < 0 ? 1 : 0;
+  }
+
   puts("DISPLAY ON");
   if (ioctl(fd, LCD_IOCTL_DISPLAY_ON) < 0) {
     perror("ioctl LED_MODE_NORMAL");
@@ -35,6 +400,48 @@ int main(void) {
   if (write(fd, buf, strlen(buf)) < 0) {
     perror("write ON");
   }
+  /* write는 프레임만 갱신하고 비동기로 전송하므로, shadow를 읽기 전에 LCD 반영까지 대기 */
+  if (fsync(fd) < 0) {
+    perror("fsync");
+  }
+
+  struct lcd_geometry geo = { 16, 2 };
+  if (ioctl(fd, LCD_IOCTL_GET_GEOMETRY, &geo) < 0) {
+    perror("ioctl LCD_IOCTL_GET_GEOMETRY");
+  }
+
+  puts("READ FROM LCD (shadow)");
+  memset(buf, 0, sizeof(buf));
+  /* 파일 오프셋 = 셀 위치이므로 write 뒤의 오프셋이 아니라 0부터 읽음 */
+  size_t cells_len = (size_t)geo.cols * geo.rows < sizeof(buf) ? (size_t)geo.cols * geo.rows : sizeof(buf);
+  ssize_t got = pread(fd, buf, cells_len, 0);
+  if (got < 0) {
+    perror("pread");
+    got = 0;
+  }
+  for (ssize_t off = 0; off < got; off += geo.cols)
+    printf("[%.*s]\n", (int)(got - off < geo.cols ? got - off : geo.cols), buf + off);
+
+  puts("PWRITE (file offset = cell position)");
+  if (pwrite(fd, "pwrite", 6, geo.cols - 6) < 0) { // 1행 오른쪽 끝
+    perror("pwrite");
+  }
+
+  puts("sleep for 3 seconds . . .");
+  sleep(3);
+
+  puts("WRITE THROUGH MMAP");
+  char* cells = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (cells == MAP_FAILED) {
+    perror("mmap");
+  }
+  else {
+    memcpy(cells + (geo.rows - 1) * geo.cols, "mmap framebuffer", geo.cols < 16 ? geo.cols : 16); // 마지막 행
+    if (ioctl(fd, LCD_IOCTL_COMMIT) < 0) {
+      perror("ioctl LCD_IOCTL_COMMIT");
+    }
+    munmap(cells, 4096);
+  }
 
   puts("sleep for 3 seconds . . .");
   sleep(3);
@@ -3,127 +3,1204 @@
 #include <linux/init.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/cdev.h>
+#include <linux/device.h>
+#include <linux/idr.h>
+#include <linux/list.h>
+#include <linux/uaccess.h>
+#include <linux/kfifo.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/mutex.h>
+#include <linux/seqlock.h>
+#include <linux/atomic.h>
+#include <linux/slab.h>
+#include <linux/kref.h>
+#include <linux/math64.h>
+#include <linux/sysfs.h>
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+#include "scd41.h"
+#include "../sensirion/sensirion_i2c.h"
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Jinhyeok Jeon");
 MODULE_DESCRIPTION("SCD41 I2C Driver (DT-based)");
 
 #define SCD41_DRV_NAME  "scd41"
+#define CLASS_NAME      "scd41_class"
+#define NODE_NAME       "scd41-%d"  /* /dev/scd41-0, /dev/scd41-1, ... */
 
-static u8 scd41_crc8(const u8* data, int len) {
-  u8 crc = 0xFF;
-  int i, j;
-  for (j = 0; j < len; j++) {
-    crc ^= data[j];
-    for (i = 0; i < 8; i++) {
-      if (crc & 0x80)
-        crc = (crc << 1) ^ 0x31;
-      else
-        crc <<= 1;
-    }
-  }
-  return crc;
-}
+#define SCD41_MAX_DEVICES  8
+
+/* 명령 (데이터시트 3.5 ~ 3.9) */
+#define SCD41_CMD_START_PERIODIC    0x21B1
+#define SCD41_CMD_START_LOW_POWER   0x21AC
+#define SCD41_CMD_READ_MEASUREMENT  0xEC05
+#define SCD41_CMD_STOP_PERIODIC     0x3F86
+#define SCD41_CMD_DATA_READY        0xE4B8
+#define SCD41_CMD_SINGLE_SHOT       0x219D
+#define SCD41_CMD_SINGLE_SHOT_RHT   0x2196
+
+/*
+ * 측정 주기 5초 (저전력 30초). 다음 측정이 나올 예상 시각 GUARD_MS 전에 깨어나
+ * POLL_MS 간격으로 data ready를 확인하고, 준비되면 바로 읽음.
+ * 예상 주기는 실제로 관측한 간격으로 보정 (센서 클럭 오차)
+ */
+#define SCD41_PERIOD_MS     5000
+#define SCD41_LOW_POWER_MS  30000
+#define SCD41_SHOT_MS       5000  /* measure_single_shot 측정 시간 */
+#define SCD41_SHOT_RHT_MS   50    /* measure_single_shot_rht_only 측정 시간 */
+#define SCD41_GUARD_MS      100
+#define SCD41_POLL_MS       20
+#define SCD41_SLOW_POLL_MS  200   /* 예상보다 1초 이상 늦으면 */
+#define SCD41_STOP_MS       500   /* stop_periodic_measurement 후 명령을 받지 않는 시간 */
+#define SCD41_SLACK_US      1000  /* 스케줄러 깨어나는 시각 허용 오차 (hrtimer slack) */
+
+/*
+ * 센서마다 주기 측정 시작 시각을 이만큼씩 벌려서 읽기 구간(예상 시각 전후)이 겹치지 않게 함.
+ * 5초 주기에 8대까지 고르게 나뉨
+ */
+#define SCD41_STAGGER_MS    (SCD41_PERIOD_MS / SCD41_MAX_DEVICES)
+
+/* 명령 실행 시간 (데이터시트), 이만큼 기다린 뒤 응답을 읽음 */
+#define SCD41_EXEC_READ_MEASUREMENT_US  1000
+#define SCD41_EXEC_DATA_READY_US        1000
+
+/*
+ * AUTO 모드: 직전 측정과의 차이가 CO2 AUTO_CO2_PPM, 온도 AUTO_TEMP_CENTI 이내인 측정이
+ * AUTO_CALM번 이어지면 저전력 주기로, 하나라도 넘으면 바로 표준 주기로 돌아감
+ */
+#define SCD41_AUTO_CO2_PPM      30
+#define SCD41_AUTO_TEMP_CENTI   20
+#define SCD41_AUTO_CALM         6
+
+/*
+ * 이동 통계. 측정 ring 하나를 모든 창이 나눠 쓰고, 창마다 자기 구간의 가장 오래된 측정(tail),
+ * 값의 합, EMA, 정렬된 값 배열을 유지. 새 측정마다 넣고 창 밖으로 나간 측정만 빼므로 측정당 일이
+ * 창 길이와 무관하게 일정 (정렬 배열의 memmove만 창 안의 측정 수에 비례, 최대 2.8KB).
+ * min/max/median은 정렬 배열의 양 끝과 가운데, mean은 합 / 개수
+ */
+#define SCD41_STATS_MAX_SAMPLES   720    /* ring 크기 = 5초 주기로 1시간, 넘치면 가장 오래된 측정부터 빠짐 (TRUNCATED) */
+#define SCD41_STATS_MAX_WINDOW_S  86400
+#define SCD41_EMA_SHIFT           16     /* EMA 고정소수점 소수부 비트 */
 
-static int last_co2_ppm;
-static int last_temp_c;  /* 0.01 단위 */
-static int last_hum_pc;  /* 0.01 단위 */
-static bool scd41_enabled = false;
+static const unsigned int scd41_stats_default_windows[SCD41_STATS_WINDOWS] = { 60, 900, 3600 };
+
+struct scd41_stats_window {
+  unsigned int window_s;    /* 0 = 사용 안 함 */
+  unsigned int tail;        /* 창 안의 가장 오래된 측정 (ring 절대 인덱스) */
+  unsigned int count;
+  s64 sum[3];               /* co2, temp, hum */
+  s64 ema[3];
+  ktime_t ema_t;            /* 마지막으로 EMA에 넣은 측정 시각 */
+  bool ema_valid;
+  bool truncated;           /* 아직 창 안인 측정이 ring에서 밀려남, 시간으로 빠지는 측정이 생기면 해제 */
+  int sorted[3][SCD41_STATS_MAX_SAMPLES];
+};
+
+struct scd41_stats {
+  unsigned int head;        /* 다음 측정의 절대 인덱스, 위치는 head % STATS_MAX_SAMPLES */
+  ktime_t t[SCD41_STATS_MAX_SAMPLES];
+  int v[SCD41_STATS_MAX_SAMPLES][3];
+  struct scd41_stats_window w[SCD41_STATS_WINDOWS];
+};
+
+/*
+ * 마지막 측정. 스케줄러만 seqlock으로 통째로 바꾸고, 읽는 쪽은 scd41_snapshot()으로
+ * 복사하므로 서로 다른 측정의 값이 섞이지 않음
+ */
+struct scd41_snapshot {
+  int co2_ppm;
+  int temp_c;   /* 0.01 단위 */
+  int hum_pc;   /* 0.01 단위 */
+  u16 co2_raw, temp_raw, hum_raw; /* IIO raw 채널 */
+  unsigned long seq;              /* 새 측정마다 1 증가, 0 = 아직 측정 없음 */
+  u64 timestamp_ns;               /* 측정이 준비된 것을 확인한 시각 (CLOCK_REALTIME) */
+  s64 iio_ts;                     /* 같은 시각의 IIO 타임스탬프 */
+  struct scd41_window_stats stats[SCD41_STATS_WINDOWS]; /* 이 측정까지의 이동 통계 */
+};
+
+/*
+ * 스케줄러가 센서마다 밟는 상태. 센서 하나를 기다리느라 스레드가 잠들지 않도록
+ * 기다림(stop 후 500ms, 단발 측정 5초, 다음 주기)은 모두 due 시각으로 표현
+ */
+enum scd41_state {
+  SCD41_ST_OFF,       /* 센서 idle, 할 일 없음 */
+  SCD41_ST_STOPPING,  /* stop 명령 후 명령을 받지 않는 동안 */
+  SCD41_ST_START,     /* 배정된 시작 슬롯에 start 명령 */
+  SCD41_ST_PERIODIC,  /* 주기 측정 중 */
+  SCD41_ST_IDLE,      /* 단발 모드, 요청 대기 */
+  SCD41_ST_SHOT,      /* 단발 측정 중 */
+};
+
+/*
+ * 센서 하나. iio_priv에는 포인터만 두고 따로 할당: 열린 파일과 IIO 장치(devm)가 참조를 잡고 있으므로
+ * unbind 후에도 둘 다 풀릴 때까지 남음 (removed 이후 파일 연산은 -ENODEV)
+ */
+struct scd41 {
+  struct i2c_client* client;
+  int id;                   /* /dev/scd41-N */
+  struct kref kref;
+  bool removed;
+  struct list_head node;    /* scd41_sensors */
 
-static int scd41_read_measurement(struct i2c_client* client) {
-  u8 cmd[2], buf[9];
+  struct scd41_snapshot last;
+  seqlock_t last_lock;
+
+  /* 사용자 요청 (enable_lock에서 바꾸고 스케줄러를 깨움) */
+  struct mutex enable_lock;
+  bool enabled;
+  bool buffer_started;      /* IIO 버퍼가 측정을 켰으면 끌 때 같이 끔 */
+  int mode;
+  bool kick;                /* 요청이 바뀜: 스케줄러가 다음 차례에 센서 상태를 맞춤 */
+  atomic_t shot_req;
+
+  /* 스케줄러 상태 (scd41_sensors_lock) */
+  enum scd41_state state;
+  ktime_t due;              /* 다음에 할 일이 있는 시각 */
+  int running;              /* 센서에서 돌고 있는 주기 측정 모드, -1 = 멈춤 */
+  int auto_mode;
+  unsigned int calm;        /* AUTO: 변화가 작은 측정이 이어진 수 */
+  u32 nominal_ms, period_ms;
+  ktime_t last_t, expected;
+  bool have_last;
+  bool shot_rht;
+
+  /* 이동 통계: 상태는 스케줄러만 만지고, 창 길이 변경은 stats_kick으로 넘김 */
+  struct scd41_stats* stats;
+  unsigned int stats_windows[SCD41_STATS_WINDOWS]; /* enable_lock */
+  bool stats_kick;
+
+  /* IIO: 새 측정마다 자체 트리거를 울려 triggered buffer로 보냄 */
+  struct iio_dev* indio;
+  struct iio_trigger* trig;
+
+  /*
+   * 측정 레코드 링 버퍼 (/dev/scd41-N). 가득 차면 가장 오래된 레코드를 버리고
+   * 새 레코드에 SCD41_STATUS_OVERRUN 표시. 모든 reader가 하나의 버퍼를 나눠 읽음
+   */
+  DECLARE_KFIFO_PTR(fifo, struct scd41_sample);
+  spinlock_t fifo_lock;
+  struct mutex fifo_resize_lock;
+  wait_queue_head_t fifo_wq;
+
+  struct cdev* cdev;        /* 열린 파일이 참조하므로 sc와 따로 해제됨 (cdev_alloc) */
+  struct device* dev;
+};
+
+static const char* const scd41_mode_names[] = {
+  [SCD41_MODE_PERIODIC] = "periodic",
+  [SCD41_MODE_LOW_POWER] = "low_power",
+  [SCD41_MODE_SINGLE_SHOT] = "single_shot",
+  [SCD41_MODE_SINGLE_SHOT_RHT] = "single_shot_rht",
+  [SCD41_MODE_AUTO] = "auto",
+};
+
+static unsigned int fifo_depth = 64;
+module_param(fifo_depth, uint, 0444);
+MODULE_PARM_DESC(fifo_depth, "initial sample ring buffer depth in records (rounded up to a power of 2)");
+
+static dev_t scd41_devt;
+static struct class* scd41_class;
+static DEFINE_IDA(scd41_ida);
+
+/* minor → 센서, open이 참조를 얻는 곳 (remove에서 비움) */
+static struct scd41* scd41_table[SCD41_MAX_DEVICES];
+static DEFINE_MUTEX(scd41_table_lock);
+
+/*
+ * 모든 센서를 스레드 하나가 돌림: 센서가 늘어도 스레드/깨어나는 횟수는 센서당 측정 수만큼만 늘고,
+ * 같은 버스의 SCD41 전송은 항상 하나씩 나감 (mux 뒤에 같은 주소 0x62로 여러 대가 있어도)
+ */
+static LIST_HEAD(scd41_sensors);
+static DEFINE_MUTEX(scd41_sensors_lock);
+static struct task_struct* scd41_sched;
+static bool scd41_sched_kick;
+static ktime_t scd41_last_start;  /* 마지막으로 배정한 시작 슬롯 */
+
+/* 1=새 측정 있음, 0=아직, 음수=에러 (하위 11비트가 0이면 준비 안 됨) */
+static int scd41_data_ready(struct i2c_client* client) {
+  u16 status;
   int ret;
-  u16 co2_raw, temp_raw, hum_raw;
-  int co2_ppm, temp_c, hum_pc;
 
-  /* 1. read command */
-  cmd[0] = 0xEC; cmd[1] = 0x05;
-  ret = i2c_master_send(client, cmd, 2);
+  ret = sensirion_i2c_read_words(client, SCD41_CMD_DATA_READY, &status, 1, SCD41_EXEC_DATA_READY_US);
   if (ret < 0) return ret;
+  return (status & 0x07FF) ? 1 : 0;
+}
 
-  msleep(1);
+static void scd41_snapshot(struct scd41* sc, struct scd41_snapshot* snap) {
+  unsigned int seq;
 
-  ret = i2c_master_recv(client, buf, 9);
-  if (ret < 0) return ret;
-  if (ret != 9) return -EIO;
+  do {
+    seq = read_seqbegin(&sc->last_lock);
+    *snap = sc->last;
+  } while (read_seqretry(&sc->last_lock, seq));
+}
+
+/* 측정값을 읽어 snap에 채움 (seq/타임스탬프는 호출자가) */
+static int scd41_read_measurement(struct i2c_client* client, struct scd41_snapshot* snap) {
+  u16 words[3];
+  int ret;
+  u16 co2_raw, temp_raw, hum_raw;
+  int co2_ppm, temp_c, hum_pc;
 
-  /* CRC 체크 */
-  if (scd41_crc8(buf, 2) != buf[2] ||
-    scd41_crc8(buf + 3, 2) != buf[5] ||
-    scd41_crc8(buf + 6, 2) != buf[8])
-    return -EIO;
+  ret = sensirion_i2c_read_words(client, SCD41_CMD_READ_MEASUREMENT, words, 3, SCD41_EXEC_READ_MEASUREMENT_US);
+  if (ret < 0) return ret;
 
   /* 파싱 */
-  co2_raw = (buf[0] << 8) | buf[1];
-  temp_raw = (buf[3] << 8) | buf[4];
-  hum_raw = (buf[6] << 8) | buf[7];
+  co2_raw = words[0];
+  temp_raw = words[1];
+  hum_raw = words[2];
 
   co2_ppm = co2_raw;
   temp_c = -4500 + (17500 * (int)temp_raw) / 65536;
   hum_pc = (10000 * (int)hum_raw) / 65536;
 
-  last_co2_ppm = co2_ppm;
-  last_temp_c = temp_c;
-  last_hum_pc = hum_pc;
+  snap->co2_ppm = co2_ppm;
+  snap->temp_c = temp_c;
+  snap->hum_pc = hum_pc;
+  snap->co2_raw = co2_raw;
+  snap->temp_raw = temp_raw;
+  snap->hum_raw = hum_raw;
 
   return 0;
 }
 
-static struct task_struct* scd41_thread;
-static int scd41_thread_fn(void* data) {
-  struct i2c_client* client = data;
-  u8 cmd[2];
-  int ret;
+static void scd41_publish(struct scd41* sc, const struct scd41_snapshot* snap) {
+  write_seqlock(&sc->last_lock);
+  sc->last = *snap;
+  write_sequnlock(&sc->last_lock);
+}
 
-  scd41_enabled = true;
-  pr_info("scd41: measurement started\n");
+/* 레코드 추가, 가득 차면 가장 오래된 것을 버림 */
+static void scd41_push_sample(struct scd41* sc, const struct scd41_snapshot* snap, unsigned int status) {
+  struct scd41_sample sample = {
+    .timestamp_ns = snap->timestamp_ns,
+    .co2 = snap->co2_ppm,
+    .temp_centi = snap->temp_c,
+    .hum_centi = snap->hum_pc,
+    .status = status,
+  };
 
-  /* Start measurement */
-  cmd[0] = 0x21; cmd[1] = 0xB1;
-  ret = i2c_master_send(client, cmd, 2);
-  if (ret < 0) {
-    pr_err("scd41: failed to start measurement\n");
-    return ret;
+  spin_lock(&sc->fifo_lock);
+  if (kfifo_is_full(&sc->fifo)) {
+    kfifo_skip(&sc->fifo);
+    sample.status |= SCD41_STATUS_OVERRUN;
   }
+  kfifo_put(&sc->fifo, sample);
+  spin_unlock(&sc->fifo_lock);
+
+  wake_up_interruptible(&sc->fifo_wq);
+}
+
+/*
+ * 새 측정을 sysfs로 알림: seq와 값 파일에 poll(POLLPRI)로 대기 중인 reader를 깨움.
+ * reader는 파일을 한 번 읽은 뒤 poll, 깨어나면 lseek(0) 후 다시 읽음
+ */
+static void scd41_notify(struct scd41* sc) {
+  static const char* const attrs[] = { "co2", "temp", "hum", "timestamp", "seq", "measurement", "stats" };
+  int i;
+
+  for (i = 0; i < ARRAY_SIZE(attrs); i++)
+    sysfs_notify(&sc->client->dev.kobj, NULL, attrs[i]);
+}
+
+/* === 이동 통계 === */
+
+/* 정렬 배열 a[0..n)에서 v 이상인 첫 위치 */
+static unsigned int scd41_sorted_pos(const int* a, unsigned int n, int v) {
+  unsigned int lo = 0, hi = n;
 
-  /* 루프: 5초마다 측정 */
-  while (true) {
-    for (int i = 0; i < 50; ++i) {
-      if (kthread_should_stop()) {
-        break;
+  while (lo < hi) {
+    unsigned int mid = (lo + hi) / 2;
+
+    if (a[mid] < v)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* 창에서 가장 오래된 측정을 뺌 */
+static void scd41_window_evict(struct scd41_stats* st, struct scd41_stats_window* w) {
+  const int* v = st->v[w->tail % SCD41_STATS_MAX_SAMPLES];
+  int q;
+
+  for (q = 0; q < 3; q++) {
+    int* a = w->sorted[q];
+    unsigned int i = scd41_sorted_pos(a, w->count, v[q]);
+
+    memmove(a + i, a + i + 1, (w->count - i - 1) * sizeof(int));
+    w->sum[q] -= v[q];
+  }
+  w->count--;
+  w->tail++;
+}
+
+/* ring의 idx번째 측정을 창에 넣고, 그 측정보다 창 길이 이상 오래된 측정을 뺌 */
+static void scd41_window_add(struct scd41_stats* st, struct scd41_stats_window* w, unsigned int idx) {
+  const int* v = st->v[idx % SCD41_STATS_MAX_SAMPLES];
+  ktime_t t = st->t[idx % SCD41_STATS_MAX_SAMPLES];
+  s64 window_ms = (s64)w->window_s * MSEC_PER_SEC;
+  s64 alpha = 0;
+  int q;
+
+  /* EMA 계수 = dt / (창 길이 + dt): 측정 간격이 바뀌어도 시정수는 창 길이 */
+  if (w->ema_valid) {
+    s64 dt = max_t(s64, ktime_ms_delta(t, w->ema_t), 0);
+
+    alpha = div64_s64(dt << SCD41_EMA_SHIFT, window_ms + dt);
+  }
+  if (w->count == 0)
+    w->tail = idx;
+
+  for (q = 0; q < 3; q++) {
+    int* a = w->sorted[q];
+    unsigned int i = scd41_sorted_pos(a, w->count, v[q]);
+
+    memmove(a + i + 1, a + i, (w->count - i) * sizeof(int));
+    a[i] = v[q];
+    w->sum[q] += v[q];
+
+    if (w->ema_valid)
+      w->ema[q] += ((((s64)v[q] << SCD41_EMA_SHIFT) - w->ema[q]) * alpha) >> SCD41_EMA_SHIFT;
+    else
+      w->ema[q] = (s64)v[q] << SCD41_EMA_SHIFT;
+  }
+  w->count++;
+  w->ema_t = t;
+  w->ema_valid = true;
+
+  /* 시간으로 빠지는 측정이 있으면 그 앞은 모두 창 밖이므로 창이 온전함 */
+  while (w->count && ktime_ms_delta(t, st->t[w->tail % SCD41_STATS_MAX_SAMPLES]) >= window_ms) {
+    scd41_window_evict(st, w);
+    w->truncated = false;
+  }
+}
+
+static void scd41_stats_add(struct scd41_stats* st, ktime_t t, const struct scd41_snapshot* snap) {
+  unsigned int slot = st->head % SCD41_STATS_MAX_SAMPLES;
+  unsigned int idx;
+  int i;
+
+  /* ring이 가득 찼으면 덮어쓸 측정을 아직 가진 창에서 먼저 뺌, 새 측정 기준으로 아직 창 안이면 창이 잘린 것 */
+  if (st->head >= SCD41_STATS_MAX_SAMPLES) {
+    for (i = 0; i < SCD41_STATS_WINDOWS; i++) {
+      struct scd41_stats_window* w = &st->w[i];
+
+      if (w->count && w->tail == st->head - SCD41_STATS_MAX_SAMPLES) {
+        s64 age = ktime_ms_delta(t, st->t[slot]);
+
+        if (age < (s64)w->window_s * MSEC_PER_SEC)
+          w->truncated = true;
+        scd41_window_evict(st, w);
       }
-      msleep(100);
     }
-    if (kthread_should_stop()) {
+  }
+
+  st->t[slot] = t;
+  st->v[slot][0] = snap->co2_ppm;
+  st->v[slot][1] = snap->temp_c;
+  st->v[slot][2] = snap->hum_pc;
+  idx = st->head++;
+
+  for (i = 0; i < SCD41_STATS_WINDOWS; i++)
+    if (st->w[i].window_s)
+      scd41_window_add(st, &st->w[i], idx);
+}
+
+/* 창 길이를 바꾸고 ring에 남아 있는 측정으로 다시 채움 */
+static void scd41_stats_set_windows(struct scd41_stats* st, const unsigned int* windows) {
+  unsigned int first = st->head > SCD41_STATS_MAX_SAMPLES ? st->head - SCD41_STATS_MAX_SAMPLES : 0;
+  unsigned int idx;
+  int i;
+
+  for (i = 0; i < SCD41_STATS_WINDOWS; i++) {
+    struct scd41_stats_window* w = &st->w[i];
+
+    w->window_s = windows[i];
+    w->count = 0;
+    memset(w->sum, 0, sizeof(w->sum));
+    w->ema_valid = false;
+    w->truncated = false;
+  }
+
+  for (idx = first; idx != st->head; idx++)
+    for (i = 0; i < SCD41_STATS_WINDOWS; i++)
+      if (st->w[i].window_s)
+        scd41_window_add(st, &st->w[i], idx);
+
+  /* ring이 한 바퀴 돌았는데 가장 오래된 측정이 아직 창 안이면 그 앞 측정도 창 안이었을 수 있음 */
+  for (i = 0; i < SCD41_STATS_WINDOWS; i++)
+    if (first && st->w[i].count && st->w[i].tail == first)
+      st->w[i].truncated = true;
+}
+
+/* 반올림 나눗셈 (음수 포함) */
+static int scd41_div_round(s64 v, unsigned int n) {
+  return div_s64(v >= 0 ? v + n / 2 : v - n / 2, n);
+}
+
+static void scd41_stats_fill(const struct scd41_stats* st, struct scd41_window_stats* out) {
+  int i, q;
+
+  for (i = 0; i < SCD41_STATS_WINDOWS; i++) {
+    const struct scd41_stats_window* w = &st->w[i];
+    struct scd41_stat* s[3] = { &out[i].co2, &out[i].temp, &out[i].hum };
+    unsigned int n = w->count;
+
+    memset(&out[i], 0, sizeof(out[i]));
+    out[i].window_s = w->window_s;
+    out[i].count = n;
+    if (n == 0)
+      continue;
+    out[i].span_s = div_s64(ktime_ms_delta(st->t[(st->head - 1) % SCD41_STATS_MAX_SAMPLES],
+      st->t[w->tail % SCD41_STATS_MAX_SAMPLES]), MSEC_PER_SEC);
+    out[i].flags = w->truncated ? SCD41_STATS_TRUNCATED : 0;
+
+    for (q = 0; q < 3; q++) {
+      const int* a = w->sorted[q];
+
+      s[q]->min = a[0];
+      s[q]->max = a[n - 1];
+      s[q]->mean = scd41_div_round(w->sum[q], n);
+      s[q]->median = (n & 1) ? a[n / 2] : (a[n / 2 - 1] + a[n / 2]) / 2;
+      s[q]->ema = (w->ema[q] + (1 << (SCD41_EMA_SHIFT - 1))) >> SCD41_EMA_SHIFT;
+    }
+  }
+}
+
+/* 요청된 창 길이 반영 후 통계만 바뀐 스냅샷을 다시 게시 (seq는 그대로) */
+static void scd41_stats_apply(struct scd41* sc) {
+  unsigned int windows[SCD41_STATS_WINDOWS];
+  struct scd41_snapshot snap;
+
+  mutex_lock(&sc->enable_lock);
+  memcpy(windows, sc->stats_windows, sizeof(windows));
+  mutex_unlock(&sc->enable_lock);
+
+  scd41_stats_set_windows(sc->stats, windows);
+  snap = sc->last;
+  scd41_stats_fill(sc->stats, snap.stats);
+  scd41_publish(sc, &snap);
+}
+
+/* 새 측정 게시: 이동 통계, 스냅샷, 레코드 버퍼, sysfs_notify, IIO 트리거 */
+static void scd41_new_sample(struct scd41* sc, struct scd41_snapshot* snap, unsigned int status) {
+  snap->seq = sc->last.seq + 1; // 쓰는 쪽은 스케줄러뿐
+  snap->timestamp_ns = ktime_get_real_ns();
+  snap->iio_ts = iio_get_time_ns(sc->indio);
+  scd41_stats_add(sc->stats, ktime_get(), snap);
+  scd41_stats_fill(sc->stats, snap->stats);
+  scd41_publish(sc, snap);
+
+  scd41_push_sample(sc, snap, status);
+  scd41_notify(sc);
+  iio_trigger_poll_nested(sc->trig);
+}
+
+/* === 스케줄러 === */
+
+/* AUTO 모드에서 다음에 쓸 주기 모드, calm = 변화가 작은 측정이 이어진 수 */
+static int scd41_auto_next(int cur, const struct scd41_snapshot* prev, const struct scd41_snapshot* snap,
+  unsigned int* calm) {
+  if (prev->seq == 0 || abs(snap->co2_ppm - prev->co2_ppm) > SCD41_AUTO_CO2_PPM ||
+    abs(snap->temp_c - prev->temp_c) > SCD41_AUTO_TEMP_CENTI) {
+    *calm = 0;
+    return SCD41_MODE_PERIODIC;
+  }
+  if (++*calm >= SCD41_AUTO_CALM)
+    return SCD41_MODE_LOW_POWER;
+  return cur;
+}
+
+/* 주기 측정 시작 시각 배정: 바로 앞에 배정한 센서의 시작과 STAGGER_MS 이상 떨어지게 */
+static ktime_t scd41_start_slot(ktime_t now) {
+  ktime_t slot = ktime_add_ms(scd41_last_start, SCD41_STAGGER_MS);
+
+  if (ktime_before(slot, now))
+    slot = now;
+  scd41_last_start = slot;
+  return slot;
+}
+
+/* 요청된 enable/mode에 센서 상태를 맞춤 (명령을 받을 수 있는 상태에서만 호출) */
+static void scd41_reconfigure(struct scd41* sc, ktime_t now) {
+  int want = -1;
+
+  if (READ_ONCE(sc->enabled)) {
+    want = READ_ONCE(sc->mode);
+    if (want == SCD41_MODE_AUTO)
+      want = sc->auto_mode;
+  }
+
+  /* 다른 모드로 주기 측정 중이면 먼저 멈춤 */
+  if (sc->running >= 0 && sc->running != want) {
+    sensirion_i2c_cmd(sc->client, SCD41_CMD_STOP_PERIODIC);
+    sc->running = -1;
+    sc->state = SCD41_ST_STOPPING;
+    sc->due = ktime_add_ms(now, SCD41_STOP_MS);
+    return;
+  }
+
+  if (want < 0) {
+    sc->state = SCD41_ST_OFF;
+    sc->due = KTIME_MAX;
+  }
+  else if (want == SCD41_MODE_SINGLE_SHOT || want == SCD41_MODE_SINGLE_SHOT_RHT) {
+    sc->state = SCD41_ST_IDLE;
+    sc->shot_rht = want == SCD41_MODE_SINGLE_SHOT_RHT;
+    sc->due = now; // 쌓인 요청이 있으면 바로
+  }
+  else if (sc->running != want) {
+    sc->state = SCD41_ST_START;
+    sc->due = scd41_start_slot(now);
+  }
+}
+
+/* data ready 폴링 한 번, 준비 안 됐으면 다음 폴링 시각을 due로 */
+static bool scd41_poll_ready(struct scd41* sc, ktime_t now) {
+  bool late;
+
+  if (scd41_data_ready(sc->client) == 1)
+    return true;
+  late = ktime_ms_delta(now, sc->expected) > 1000;
+  sc->due = ktime_add_ms(now, late ? SCD41_SLOW_POLL_MS : SCD41_POLL_MS);
+  return false;
+}
+
+static void scd41_step_periodic(struct scd41* sc, ktime_t now) {
+  struct scd41_snapshot snap;
+  struct scd41_snapshot prev = sc->last;
+
+  if (!scd41_poll_ready(sc, now))
+    return;
+
+  if (scd41_read_measurement(sc->client, &snap) == 0) {
+    scd41_new_sample(sc, &snap, sc->have_last ? 0 : SCD41_STATUS_FIRST);
+    sc->auto_mode = scd41_auto_next(sc->auto_mode, &prev, &snap, &sc->calm);
+  }
+
+  /* 관측한 간격으로 예상 주기 보정 (첫 측정은 시작 지연이 섞이므로 제외) */
+  if (sc->have_last) {
+    u32 interval = ktime_ms_delta(now, sc->last_t);
+
+    interval = clamp_t(u32, interval, sc->nominal_ms / 2, sc->nominal_ms * 2);
+    sc->period_ms = (sc->period_ms * 3 + interval) / 4;
+  }
+  sc->have_last = true;
+  sc->last_t = now;
+  sc->expected = ktime_add_ms(now, sc->period_ms);
+  sc->due = ktime_sub_ms(sc->expected, SCD41_GUARD_MS);
+
+  if (READ_ONCE(sc->mode) == SCD41_MODE_AUTO && sc->auto_mode != sc->running)
+    scd41_reconfigure(sc, now);
+}
+
+/* 단발 측정 결과. RH/T 전용 측정은 CO2가 0으로 나오므로 이전 CO2 값을 유지 */
+static void scd41_step_shot(struct scd41* sc, ktime_t now) {
+  struct scd41_snapshot snap;
+  int ret;
+
+  if (!scd41_poll_ready(sc, now))
+    return;
+
+  ret = scd41_read_measurement(sc->client, &snap);
+  if (ret == 0) {
+    if (sc->shot_rht) {
+      snap.co2_ppm = sc->last.co2_ppm;
+      snap.co2_raw = sc->last.co2_raw;
+    }
+    scd41_new_sample(sc, &snap, sc->shot_rht ? SCD41_STATUS_RHT_ONLY : 0);
+  }
+  else {
+    dev_err(&sc->client->dev, "single shot measurement failed: %d\n", ret);
+  }
+  sc->state = SCD41_ST_IDLE;
+  sc->due = now;
+}
+
+/* 센서 하나의 할 일을 처리하고 다음 due 반환. 시간이 걸리는 대기는 하지 않음 */
+static ktime_t scd41_step(struct scd41* sc, ktime_t now) {
+  int mode, ret;
+
+  if (READ_ONCE(sc->stats_kick)) {
+    WRITE_ONCE(sc->stats_kick, false);
+    scd41_stats_apply(sc);
+  }
+
+  /* 요청 변경은 명령을 받을 수 있을 때 반영 (stop 직후, 단발 측정 중에는 끝난 뒤) */
+  if (READ_ONCE(sc->kick) && sc->state != SCD41_ST_STOPPING && sc->state != SCD41_ST_SHOT) {
+    WRITE_ONCE(sc->kick, false);
+    scd41_reconfigure(sc, now);
+  }
+  if (ktime_before(now, sc->due))
+    return sc->due;
+
+  switch (sc->state) {
+  case SCD41_ST_OFF:
+    break;
+
+  case SCD41_ST_STOPPING:
+    sc->state = SCD41_ST_OFF;
+    scd41_reconfigure(sc, now);
+    break;
+
+  case SCD41_ST_START:
+    mode = READ_ONCE(sc->mode) == SCD41_MODE_AUTO ? sc->auto_mode : READ_ONCE(sc->mode);
+    ret = sensirion_i2c_cmd(sc->client,
+      mode == SCD41_MODE_LOW_POWER ? SCD41_CMD_START_LOW_POWER : SCD41_CMD_START_PERIODIC);
+    if (ret < 0) {
+      dev_err(&sc->client->dev, "failed to start measurement\n"); // enable/mode를 다시 쓰면 재시도
+      sc->state = SCD41_ST_OFF;
+      sc->due = KTIME_MAX;
       break;
     }
-    scd41_read_measurement(client);
+    dev_info(&sc->client->dev, "scd41-%d: %s measurement started\n", sc->id, scd41_mode_names[mode]);
+    sc->running = mode;
+    sc->state = SCD41_ST_PERIODIC;
+    sc->nominal_ms = sc->period_ms = mode == SCD41_MODE_LOW_POWER ? SCD41_LOW_POWER_MS : SCD41_PERIOD_MS;
+    sc->have_last = false;
+    sc->last_t = now;
+    sc->expected = ktime_add_ms(now, sc->period_ms);
+    sc->due = ktime_sub_ms(sc->expected, SCD41_GUARD_MS);
+    break;
+
+  case SCD41_ST_PERIODIC:
+    scd41_step_periodic(sc, now);
+    break;
+
+  case SCD41_ST_IDLE:
+    if (!atomic_xchg(&sc->shot_req, 0)) {
+      sc->due = KTIME_MAX;
+      break;
+    }
+    ret = sensirion_i2c_cmd(sc->client, sc->shot_rht ? SCD41_CMD_SINGLE_SHOT_RHT : SCD41_CMD_SINGLE_SHOT);
+    if (ret < 0) {
+      dev_err(&sc->client->dev, "single shot measurement failed: %d\n", ret);
+      sc->due = KTIME_MAX; // 요청은 버림, 다음 요청 때 다시
+      break;
+    }
+    sc->state = SCD41_ST_SHOT;
+    sc->expected = ktime_add_ms(now, sc->shot_rht ? SCD41_SHOT_RHT_MS : SCD41_SHOT_MS);
+    sc->due = ktime_sub_ms(sc->expected, SCD41_GUARD_MS);
+    break;
+
+  case SCD41_ST_SHOT:
+    scd41_step_shot(sc, now);
+    break;
   }
+  return sc->due;
+}
+
+/*
+ * deadline(절대 시각)까지 잠듦, kthread_stop()이나 요청 변경(scd41_sched_kick)이 깨우면 바로.
+ * ms/jiffies로 바꾸지 않고 hrtimer로 자므로 1ms 미만 남은 시간도 바쁜 대기 없이 잠
+ */
+static void scd41_sched_sleep(ktime_t deadline) {
+  set_current_state(TASK_INTERRUPTIBLE);
+  if (!kthread_should_stop() && !READ_ONCE(scd41_sched_kick)) {
+    if (deadline == KTIME_MAX)
+      schedule();
+    else
+      schedule_hrtimeout_range(&deadline, SCD41_SLACK_US * NSEC_PER_USEC, HRTIMER_MODE_ABS);
+  }
+  __set_current_state(TASK_RUNNING);
+}
+
+static int scd41_sched_fn(void* data) {
+  struct scd41* sc;
+  ktime_t next;
 
-  /* Stop measurement */
-  cmd[0] = 0x3F; cmd[1] = 0x86;
-  i2c_master_send(client, cmd, 2);
-  pr_info("scd41: measurement stopped\n");
+  while (!kthread_should_stop()) {
+    WRITE_ONCE(scd41_sched_kick, false);
+    next = KTIME_MAX;
 
-  scd41_enabled = false;
+    mutex_lock(&scd41_sensors_lock);
+    list_for_each_entry(sc, &scd41_sensors, node) {
+      ktime_t due = scd41_step(sc, ktime_get());
 
+      if (ktime_before(due, next))
+        next = due;
+    }
+    mutex_unlock(&scd41_sensors_lock);
+
+    scd41_sched_sleep(next);
+  }
   return 0;
 }
 
+static void scd41_sched_wake(void) {
+  WRITE_ONCE(scd41_sched_kick, true);
+  wake_up_process(scd41_sched);
+}
+
+/* 요청이 바뀐 센서를 표시하고 스케줄러를 깨움 */
+static void scd41_kick(struct scd41* sc) {
+  WRITE_ONCE(sc->kick, true);
+  scd41_sched_wake();
+}
+
+/* 0.01 단위 값 → "23.45", "-0.50" */
+static int scd41_sprint_centi(char* buf, int v, const char* end) {
+  return sprintf(buf, "%s%d.%02d%s", v < 0 ? "-" : "", abs(v) / 100, abs(v) % 100, end);
+}
+
 static ssize_t co2_show(struct device* dev, struct device_attribute* attr, char* buf) {
-  return sprintf(buf, "%d\n", last_co2_ppm);
+  struct scd41_snapshot snap;
+
+  scd41_snapshot(dev_get_drvdata(dev), &snap);
+  return sprintf(buf, "%d\n", snap.co2_ppm);
 }
 static ssize_t temp_show(struct device* dev, struct device_attribute* attr, char* buf) {
-  return sprintf(buf, "%d.%02d\n", last_temp_c / 100, last_temp_c % 100);
+  struct scd41_snapshot snap;
+
+  scd41_snapshot(dev_get_drvdata(dev), &snap);
+  return scd41_sprint_centi(buf, snap.temp_c, "\n");
 }
 static ssize_t hum_show(struct device* dev, struct device_attribute* attr, char* buf) {
-  return sprintf(buf, "%d.%02d\n", last_hum_pc / 100, last_hum_pc % 100);
+  struct scd41_snapshot snap;
+
+  scd41_snapshot(dev_get_drvdata(dev), &snap);
+  return scd41_sprint_centi(buf, snap.hum_pc, "\n");
+}
+
+/* 측정 켜기/끄기 (sc->enable_lock), 실제 명령은 스케줄러가 */
+static void scd41_set_enabled(struct scd41* sc, bool on) {
+  WRITE_ONCE(sc->enabled, on);
+  scd41_kick(sc);
+}
+
+static int scd41_set_mode(struct scd41* sc, int mode) {
+  if (mode < 0 || mode >= ARRAY_SIZE(scd41_mode_names))
+    return -EINVAL;
+
+  mutex_lock(&sc->enable_lock);
+  atomic_set(&sc->shot_req, 0); // 이전 모드에서 남은 요청은 버림
+  WRITE_ONCE(sc->mode, mode);
+  scd41_kick(sc);
+  mutex_unlock(&sc->enable_lock);
+  return 0;
+}
+
+/* 단발 측정 요청, 측정이 진행 중이면 끝난 뒤 한 번 더 (요청은 합쳐짐) */
+static int scd41_request_shot(struct scd41* sc) {
+  int mode;
+  int ret = 0;
+
+  mutex_lock(&sc->enable_lock);
+  mode = READ_ONCE(sc->mode);
+  if (mode != SCD41_MODE_SINGLE_SHOT && mode != SCD41_MODE_SINGLE_SHOT_RHT) {
+    ret = -EINVAL;
+  }
+  else if (!sc->enabled) {
+    ret = -EAGAIN; // enable = 1 필요
+  }
+  else {
+    atomic_set(&sc->shot_req, 1);
+    scd41_kick(sc);
+  }
+  mutex_unlock(&sc->enable_lock);
+  return ret;
+}
+
+/* === IIO === */
+/*
+ * raw → 단위: CO2 ppm * 0.0001 = %, 온도 (raw - 16852.1) * 175000/65536 = m°C,
+ * 습도 raw * 100000/65536 = m%RH (IIO ABI 단위)
+ */
+static const struct iio_chan_spec scd41_channels[] = {
+  {
+    .type = IIO_CONCENTRATION,
+    .modified = 1,
+    .channel2 = IIO_MOD_CO2,
+    .info_mask_separate = BIT(IIO_CHAN_INFO_RAW) | BIT(IIO_CHAN_INFO_SCALE),
+    .scan_index = 0,
+    .scan_type = { .sign = 'u', .realbits = 16, .storagebits = 16, .endianness = IIO_CPU },
+  },
+  {
+    .type = IIO_TEMP,
+    .info_mask_separate = BIT(IIO_CHAN_INFO_RAW) | BIT(IIO_CHAN_INFO_SCALE) | BIT(IIO_CHAN_INFO_OFFSET),
+    .scan_index = 1,
+    .scan_type = { .sign = 'u', .realbits = 16, .storagebits = 16, .endianness = IIO_CPU },
+  },
+  {
+    .type = IIO_HUMIDITYRELATIVE,
+    .info_mask_separate = BIT(IIO_CHAN_INFO_RAW) | BIT(IIO_CHAN_INFO_SCALE),
+    .scan_index = 2,
+    .scan_type = { .sign = 'u', .realbits = 16, .storagebits = 16, .endianness = IIO_CPU },
+  },
+  IIO_CHAN_SOFT_TIMESTAMP(3),
+};
+
+static struct scd41* scd41_from_iio(struct iio_dev* indio_dev) {
+  return *(struct scd41**)iio_priv(indio_dev);
+}
+
+/* 세 채널은 항상 같이 읽히므로 전체만 허용, 일부만 켜면 IIO 코어가 골라냄 */
+static const unsigned long scd41_scan_masks[] = { 0x7, 0 };
+
+static int scd41_read_raw(struct iio_dev* indio_dev, const struct iio_chan_spec* chan,
+  int* val, int* val2, long mask) {
+  struct scd41_snapshot snap;
+
+  switch (mask) {
+  case IIO_CHAN_INFO_RAW:
+    scd41_snapshot(scd41_from_iio(indio_dev), &snap);
+    if (!snap.seq)
+      return -ENODATA;
+    if (chan->type == IIO_CONCENTRATION)
+      *val = snap.co2_raw;
+    else if (chan->type == IIO_TEMP)
+      *val = snap.temp_raw;
+    else
+      *val = snap.hum_raw;
+    return IIO_VAL_INT;
+
+  case IIO_CHAN_INFO_SCALE:
+    if (chan->type == IIO_CONCENTRATION) {
+      *val = 0;
+      *val2 = 100; // ppm → %
+      return IIO_VAL_INT_PLUS_MICRO;
+    }
+    *val = chan->type == IIO_TEMP ? 175000 : 100000;
+    *val2 = 65536;
+    return IIO_VAL_FRACTIONAL;
+
+  case IIO_CHAN_INFO_OFFSET:
+    *val = -45 * 65536; // -45 °C를 raw 단위로
+    *val2 = 175;
+    return IIO_VAL_FRACTIONAL;
+  }
+  return -EINVAL;
+}
+
+static const struct iio_info scd41_iio_info = {
+  .read_raw = scd41_read_raw,
+  .validate_trigger = iio_validate_own_trigger,
+};
+
+static irqreturn_t scd41_trigger_handler(int irq, void* p) {
+  struct iio_poll_func* pf = p;
+  struct iio_dev* indio_dev = pf->indio_dev;
+  struct scd41_snapshot snap;
+  struct {
+    u16 data[3];
+    s64 ts __aligned(8);
+  } scan;
+
+  scd41_snapshot(scd41_from_iio(indio_dev), &snap);
+  memset(&scan, 0, sizeof(scan));
+  scan.data[0] = snap.co2_raw;
+  scan.data[1] = snap.temp_raw;
+  scan.data[2] = snap.hum_raw;
+  iio_push_to_buffers_with_timestamp(indio_dev, &scan, snap.iio_ts);
+
+  iio_trigger_notify_done(indio_dev->trig);
+  return IRQ_HANDLED;
+}
+
+/* 버퍼를 켜면 측정이 꺼져 있을 때 켜고, 버퍼를 끌 때 같이 끔 */
+static int scd41_buffer_postenable(struct iio_dev* indio_dev) {
+  struct scd41* sc = scd41_from_iio(indio_dev);
+
+  mutex_lock(&sc->enable_lock);
+  if (!sc->enabled) {
+    scd41_set_enabled(sc, true);
+    sc->buffer_started = true;
+  }
+  mutex_unlock(&sc->enable_lock);
+  return 0;
+}
+
+static int scd41_buffer_predisable(struct iio_dev* indio_dev) {
+  struct scd41* sc = scd41_from_iio(indio_dev);
+
+  mutex_lock(&sc->enable_lock);
+  if (sc->buffer_started) {
+    scd41_set_enabled(sc, false);
+    sc->buffer_started = false;
+  }
+  mutex_unlock(&sc->enable_lock);
+  return 0;
+}
+
+static const struct iio_buffer_setup_ops scd41_buffer_ops = {
+  .postenable = scd41_buffer_postenable,
+  .predisable = scd41_buffer_predisable,
+};
+
+static int scd41_iio_init(struct scd41* sc) {
+  struct iio_dev* indio_dev = sc->indio;
+  struct device* dev = &sc->client->dev;
+  int ret;
+
+  indio_dev->name = SCD41_DRV_NAME;
+  indio_dev->info = &scd41_iio_info;
+  indio_dev->channels = scd41_channels;
+  indio_dev->num_channels = ARRAY_SIZE(scd41_channels);
+  indio_dev->available_scan_masks = scd41_scan_masks;
+  indio_dev->modes = INDIO_DIRECT_MODE;
+
+  sc->trig = devm_iio_trigger_alloc(dev, "%s-dev%d", indio_dev->name, iio_device_id(indio_dev));
+  if (!sc->trig)
+    return -ENOMEM;
+  ret = devm_iio_trigger_register(dev, sc->trig);
+  if (ret)
+    return ret;
+  indio_dev->trig = iio_trigger_get(sc->trig);
+
+  ret = devm_iio_triggered_buffer_setup(dev, indio_dev, NULL, scd41_trigger_handler, &scd41_buffer_ops);
+  if (ret)
+    return ret;
+
+  return devm_iio_device_register(dev, indio_dev);
+}
+
+/* === /dev/scd41-N === */
+#define SCD41_READ_CHUNK  16
+
+/* === 수명 === */
+
+/* 마지막 참조(probe의 devm action, 열린 파일)가 풀리면 버퍼와 메모리 해제 */
+static void scd41_free(struct kref* kref) {
+  struct scd41* sc = container_of(kref, struct scd41, kref);
+
+  kfifo_free(&sc->fifo);
+  kvfree(sc->stats);
+  kfree(sc);
+}
+
+static void scd41_put(struct scd41* sc) {
+  kref_put(&sc->kref, scd41_free);
+}
+
+/* devm: IIO 장치와 트리거가 해제된 뒤에 probe의 참조를 풂 */
+static void scd41_put_action(void* data) {
+  scd41_put(data);
+}
+
+static bool scd41_gone(struct scd41* sc) {
+  return READ_ONCE(sc->removed);
+}
+
+static int scd41_open(struct inode* inode, struct file* file) {
+  struct scd41* sc;
+
+  mutex_lock(&scd41_table_lock);
+  sc = scd41_table[iminor(inode)];
+  if (sc)
+    kref_get(&sc->kref);
+  mutex_unlock(&scd41_table_lock);
+  if (!sc)
+    return -ENODEV;
+
+  file->private_data = sc;
+  return 0;
+}
+
+static int scd41_release(struct inode* inode, struct file* file) {
+  scd41_put(file->private_data);
+  return 0;
+}
+
+/* 레코드 단위로 읽음, 비어 있으면 새 레코드가 올 때까지 대기 (O_NONBLOCK이면 -EAGAIN) */
+static ssize_t scd41_read(struct file* file, char __user* buf, size_t len, loff_t* off) {
+  struct scd41* sc = file->private_data;
+  struct scd41_sample chunk[SCD41_READ_CHUNK];
+  size_t want = len / sizeof(struct scd41_sample);
+  size_t done = 0;
+  unsigned int n;
+  int ret;
+
+  if (want == 0)
+    return -EINVAL;
+
+  while (kfifo_is_empty(&sc->fifo)) {
+    if (scd41_gone(sc))
+      return -ENODEV;
+    if (file->f_flags & O_NONBLOCK)
+      return -EAGAIN;
+    ret = wait_event_interruptible(sc->fifo_wq, !kfifo_is_empty(&sc->fifo) || scd41_gone(sc));
+    if (ret)
+      return ret;
+  }
+
+  /* copy_to_user는 락 밖에서, 조금씩 꺼내 복사 */
+  while (done < want) {
+    spin_lock(&sc->fifo_lock);
+    n = kfifo_out(&sc->fifo, chunk, min_t(size_t, want - done, SCD41_READ_CHUNK));
+    spin_unlock(&sc->fifo_lock);
+    if (n == 0)
+      break;
+
+    if (copy_to_user(buf + done * sizeof(struct scd41_sample), chunk, n * sizeof(struct scd41_sample)))
+      return done ? done * sizeof(struct scd41_sample) : -EFAULT;
+    done += n;
+  }
+
+  return done * sizeof(struct scd41_sample);
+}
+
+static __poll_t scd41_poll(struct file* file, poll_table* wait) {
+  struct scd41* sc = file->private_data;
+
+  poll_wait(file, &sc->fifo_wq, wait);
+  if (scd41_gone(sc))
+    return EPOLLERR | EPOLLHUP;
+  return kfifo_is_empty(&sc->fifo) ? 0 : EPOLLIN | EPOLLRDNORM;
+}
+
+/* 센서 상태를 바꾸는 SET_MODE / MEASURE는 쓰기로 연 파일만 (노드가 0644라 root), GET_MODE는 누구나 */
+static long scd41_ioctl(struct file* file, unsigned int cmd, unsigned long arg) {
+  struct scd41* sc = file->private_data;
+  int mode;
+
+  if (scd41_gone(sc))
+    return -ENODEV;
+
+  if ((cmd == SCD41_IOCTL_SET_MODE || cmd == SCD41_IOCTL_MEASURE) && !(file->f_mode & FMODE_WRITE))
+    return -EBADF;
+
+  switch (cmd) {
+  case SCD41_IOCTL_SET_MODE:
+    if (copy_from_user(&mode, (int __user*)arg, sizeof(int)))
+      return -EFAULT;
+    return scd41_set_mode(sc, mode);
+
+  case SCD41_IOCTL_GET_MODE:
+    mode = READ_ONCE(sc->mode);
+    return copy_to_user((int __user*)arg, &mode, sizeof(int)) ? -EFAULT : 0;
+
+  case SCD41_IOCTL_MEASURE:
+    return scd41_request_shot(sc);
+  }
+  return -ENOTTY;
+}
+
+static const struct file_operations scd41_fops = {
+  .owner = THIS_MODULE,
+  .open = scd41_open,
+  .release = scd41_release,
+  .read = scd41_read,
+  .poll = scd41_poll,
+  .unlocked_ioctl = scd41_ioctl,
+  .llseek = noop_llseek,
+};
+
+static char* scd41_devnode(const struct device* dev, umode_t* mode) {
+  if (mode) {
+    *mode = 0644; // rw-r--r--, 쓰기 권한은 상태를 바꾸는 ioctl용 (write()는 없음)
+  }
+  return NULL;
+}
+
+/* 버퍼 깊이 변경: 새 버퍼로 교체, 쌓여 있던 레코드는 버림 */
+static int scd41_fifo_resize(struct scd41* sc, unsigned int depth) {
+  typeof(sc->fifo) fifo;
+  int ret;
+
+  if (depth < 2 || depth > 4096)
+    return -EINVAL;
+
+  mutex_lock(&sc->fifo_resize_lock);
+  ret = kfifo_alloc(&fifo, depth, GFP_KERNEL);
+  if (ret == 0) {
+    spin_lock(&sc->fifo_lock);
+    swap(sc->fifo, fifo);
+    spin_unlock(&sc->fifo_lock);
+    kfifo_free(&fifo);
+  }
+  mutex_unlock(&sc->fifo_resize_lock);
+  return ret;
+}
+
+static ssize_t fifo_depth_show(struct device* dev, struct device_attribute* attr, char* buf) {
+  struct scd41* sc = dev_get_drvdata(dev);
+
+  return sprintf(buf, "%u\n", kfifo_size(&sc->fifo));
+}
+static ssize_t fifo_depth_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t count) {
+  unsigned int depth;
+  int ret;
+
+  ret = kstrtouint(buf, 0, &depth);
+  if (ret)
+    return ret;
+  ret = scd41_fifo_resize(dev_get_drvdata(dev), depth);
+  return ret ? ret : count;
+}
+
+/* 마지막 측정이 만들어진 시각 (CLOCK_REALTIME, ns), 측정 전이면 0 */
+static ssize_t timestamp_show(struct device* dev, struct device_attribute* attr, char* buf) {
+  struct scd41_snapshot snap;
+
+  scd41_snapshot(dev_get_drvdata(dev), &snap);
+  return sprintf(buf, "%llu\n", snap.timestamp_ns);
+}
+/* 지금까지의 측정 수, 새 측정마다 sysfs_notify */
+static ssize_t seq_show(struct device* dev, struct device_attribute* attr, char* buf) {
+  struct scd41_snapshot snap;
+
+  scd41_snapshot(dev_get_drvdata(dev), &snap);
+  return sprintf(buf, "%lu\n", snap.seq);
+}
+
+/* 한 측정의 값을 한 줄로: "co2 temp hum seq timestamp" */
+static ssize_t measurement_show(struct device* dev, struct device_attribute* attr, char* buf) {
+  struct scd41_snapshot snap;
+  int len;
+
+  scd41_snapshot(dev_get_drvdata(dev), &snap);
+  len = sprintf(buf, "%d ", snap.co2_ppm);
+  len += scd41_sprint_centi(buf + len, snap.temp_c, " ");
+  len += scd41_sprint_centi(buf + len, snap.hum_pc, " ");
+  len += sprintf(buf + len, "%lu %llu\n", snap.seq, snap.timestamp_ns);
+  return len;
+}
+
+/* 바이너리 스냅샷: struct scd41_measurement 하나를 pread()로 */
+static ssize_t measurement_bin_read(struct file* file, struct kobject* kobj, struct bin_attribute* attr,
+  char* buf, loff_t off, size_t count) {
+  struct scd41_snapshot snap;
+  struct scd41_measurement m;
+
+  if (off >= sizeof(m))
+    return 0;
+
+  scd41_snapshot(dev_get_drvdata(kobj_to_dev(kobj)), &snap);
+  m = (struct scd41_measurement) {
+    .timestamp_ns = snap.timestamp_ns,
+    .seq = snap.seq,
+    .co2 = snap.co2_ppm,
+    .temp_centi = snap.temp_c,
+    .hum_centi = snap.hum_pc,
+  };
+  memcpy(m.stats, snap.stats, sizeof(m.stats));
+
+  count = min_t(size_t, count, sizeof(m) - off);
+  memcpy(buf, (char*)&m + off, count);
+  return count;
 }
 static ssize_t enable_show(struct device* dev, struct device_attribute* attr, char* buf) {
-  return sprintf(buf, "%d\n", scd41_enabled ? 1 : 0);
+  struct scd41* sc = dev_get_drvdata(dev);
+
+  return sprintf(buf, "%d\n", READ_ONCE(sc->enabled) ? 1 : 0);
 }
 static ssize_t enable_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t count) {
+  struct scd41* sc = dev_get_drvdata(dev);
   char tmp[16];
+  int ret = 0;
 
   if (count >= sizeof(tmp) - 1) {
     return -EINVAL;
@@ -132,75 +1209,302 @@ static ssize_t enable_store(struct device* dev, struct device_attribute* attr, c
   memcpy(tmp, buf, count);
   tmp[count] = '\0';
 
+  mutex_lock(&sc->enable_lock);
   if (!strcmp(tmp, "1") || !strcmp(tmp, "1\n")) {
-    if (scd41_enabled) {
-      return count;
-    }
-    scd41_thread = kthread_run(scd41_thread_fn, dev_get_drvdata(dev), "scd41_thread");
-    if (IS_ERR(scd41_thread)) {
-      pr_err("scd41: failed to create kthread\n");
-      return PTR_ERR(scd41_thread);
-    }
+    scd41_set_enabled(sc, true);
   }
   else if (!strcmp(tmp, "0") || !strcmp(tmp, "0\n")) {
-    if (!scd41_enabled) {
-      return count;
-    }
-    if (scd41_thread) {
-      kthread_stop(scd41_thread);
-      scd41_thread = NULL;
-    }
+    scd41_set_enabled(sc, false);
   }
   else {
-    return -EINVAL;
+    ret = -EINVAL;
   }
+  if (ret == 0)
+    sc->buffer_started = false; // 이제 enable로 켜고 끔
+  mutex_unlock(&sc->enable_lock);
 
+  return ret ? ret : count;
+}
+
+/* 측정 모드: 이름(periodic, low_power, single_shot, single_shot_rht, auto) 또는 번호 */
+static ssize_t mode_show(struct device* dev, struct device_attribute* attr, char* buf) {
+  struct scd41* sc = dev_get_drvdata(dev);
+
+  return sprintf(buf, "%s\n", scd41_mode_names[READ_ONCE(sc->mode)]);
+}
+static ssize_t mode_store(struct device* dev, struct device_attribute* attr, const char* buf, size_t count) {
+  int mode;
+  int ret;
+
+  mode = sysfs_match_string(scd41_mode_names, buf);
+  if (mode < 0 && kstrtoint(buf, 0, &mode))
+    return -EINVAL;
+  ret = scd41_set_mode(dev_get_drvdata(dev), mode);
+  return ret ? ret : count;
+}
+
+/* 이동 통계 창 길이 (초), 최대 3개: "60 900 3600". 0 또는 생략 = 그 창은 사용 안 함 */
+static ssize_t stats_windows_show(struct device* dev, struct device_attribute* attr, char* buf) {
+  struct scd41* sc = dev_get_drvdata(dev);
+  unsigned int w[SCD41_STATS_WINDOWS];
+
+  mutex_lock(&sc->enable_lock);
+  memcpy(w, sc->stats_windows, sizeof(w));
+  mutex_unlock(&sc->enable_lock);
+  return sprintf(buf, "%u %u %u\n", w[0], w[1], w[2]);
+}
+static ssize_t stats_windows_store(struct device* dev, struct device_attribute* attr, const char* buf,
+  size_t count) {
+  struct scd41* sc = dev_get_drvdata(dev);
+  unsigned int w[SCD41_STATS_WINDOWS] = { 0 };
+  int i;
+
+  if (sscanf(buf, "%u %u %u", &w[0], &w[1], &w[2]) < 1)
+    return -EINVAL;
+  for (i = 0; i < SCD41_STATS_WINDOWS; i++)
+    if (w[i] > SCD41_STATS_MAX_WINDOW_S)
+      return -EINVAL;
+
+  /* 통계 상태는 스케줄러가 바꿈 (지금까지의 측정으로 새 창을 다시 채움) */
+  mutex_lock(&sc->enable_lock);
+  memcpy(sc->stats_windows, w, sizeof(w));
+  WRITE_ONCE(sc->stats_kick, true);
+  scd41_sched_wake();
+  mutex_unlock(&sc->enable_lock);
   return count;
 }
 
+static int scd41_sprint_stat(char* buf, const struct scd41_window_stats* ws, const char* name,
+  const struct scd41_stat* s, bool centi) {
+  const int v[] = { s->min, s->max, s->mean, s->median, s->ema };
+  int len, i;
+
+  len = sprintf(buf, "%u %u %u %u %s", ws->window_s, ws->count, ws->span_s,
+    !!(ws->flags & SCD41_STATS_TRUNCATED), name);
+  for (i = 0; i < ARRAY_SIZE(v); i++) {
+    len += sprintf(buf + len, " ");
+    if (centi)
+      len += scd41_sprint_centi(buf + len, v[i], "");
+    else
+      len += sprintf(buf + len, "%d", v[i]);
+  }
+  return len + sprintf(buf + len, "\n");
+}
+
+/* 창마다 세 줄: "window_s count span_s truncated 이름 min max mean median ema" (켜진 창만) */
+static ssize_t stats_show(struct device* dev, struct device_attribute* attr, char* buf) {
+  struct scd41_snapshot snap;
+  int len = 0;
+  int i;
+
+  scd41_snapshot(dev_get_drvdata(dev), &snap);
+  for (i = 0; i < SCD41_STATS_WINDOWS; i++) {
+    const struct scd41_window_stats* ws = &snap.stats[i];
+
+    if (!ws->window_s)
+      continue;
+    len += scd41_sprint_stat(buf + len, ws, "co2", &ws->co2, false);
+    len += scd41_sprint_stat(buf + len, ws, "temp", &ws->temp, true);
+    len += scd41_sprint_stat(buf + len, ws, "hum", &ws->hum, true);
+  }
+  return len;
+}
+
 /* struct device_attribute: sysfs에 만들어질 파일 하나 */
 /* DEVICE_ATTR_R0(name) 매크로가 만들어줌 */
 /* struct device_attribute dev_attr_co2 = { .attr = { .name = "co2", .mode = 0444 }, .show = co2_show, } */
 static DEVICE_ATTR_RO(co2);
 static DEVICE_ATTR_RO(temp);
 static DEVICE_ATTR_RO(hum);
+static DEVICE_ATTR_RO(timestamp);
+static DEVICE_ATTR_RO(seq);
+static DEVICE_ATTR_RO(measurement);
+static BIN_ATTR_RO(measurement_bin, sizeof(struct scd41_measurement));
 static DEVICE_ATTR_RW(enable);
+static DEVICE_ATTR_RW(fifo_depth);
+static DEVICE_ATTR_RW(mode);
+static DEVICE_ATTR_RW(stats_windows);
+static DEVICE_ATTR_RO(stats);
 
 static struct attribute* scd41_attrs[] = {
   &dev_attr_co2.attr,
   &dev_attr_temp.attr,
   &dev_attr_hum.attr,
+  &dev_attr_timestamp.attr,
+  &dev_attr_seq.attr,
+  &dev_attr_measurement.attr,
   &dev_attr_enable.attr,
+  &dev_attr_fifo_depth.attr,
+  &dev_attr_mode.attr,
+  &dev_attr_stats_windows.attr,
+  &dev_attr_stats.attr,
+  NULL,
+};
+
+static struct bin_attribute* scd41_bin_attrs[] = {
+  &bin_attr_measurement_bin,
   NULL,
 };
 
 static const struct attribute_group scd41_group = {
     .attrs = scd41_attrs,
+    .bin_attrs = scd41_bin_attrs,
 };
 
-/* probe: 모듈 로딩 시 Device Tree에서 client 매칭되면 호출 */
+/* probe: Device Tree에서 client 매칭될 때마다 호출 (센서마다 /dev/scd41-N) */
 static int scd41_probe(struct i2c_client* client) {
+  struct iio_dev* indio_dev;
+  struct scd41* sc;
   int ret;
 
-  pr_info("scd41: probe called, addr=0x%02x\n", client->addr);
+  sc = kzalloc(sizeof(*sc), GFP_KERNEL);
+  if (!sc)
+    return -ENOMEM;
 
-  ret = sysfs_create_group(&client->dev.kobj, &scd41_group);
+  sc->client = client;
+  kref_init(&sc->kref);
+  seqlock_init(&sc->last_lock);
+  mutex_init(&sc->enable_lock);
+  sc->mode = SCD41_MODE_PERIODIC;
+  atomic_set(&sc->shot_req, 0);
+  sc->state = SCD41_ST_OFF;
+  sc->due = KTIME_MAX;
+  sc->running = -1;
+  sc->auto_mode = SCD41_MODE_PERIODIC;
+  spin_lock_init(&sc->fifo_lock);
+  mutex_init(&sc->fifo_resize_lock);
+  init_waitqueue_head(&sc->fifo_wq);
+  i2c_set_clientdata(client, sc);
+
+  /* 이동 통계 상태는 약 40KB라 kvzalloc으로 따로 */
+  sc->stats = kvzalloc(sizeof(*sc->stats), GFP_KERNEL);
+  if (!sc->stats) {
+    ret = -ENOMEM;
+    goto err_free;
+  }
+  memcpy(sc->stats_windows, scd41_stats_default_windows, sizeof(sc->stats_windows));
+  scd41_stats_set_windows(sc->stats, sc->stats_windows);
+  scd41_stats_fill(sc->stats, sc->last.stats);
+
+  ret = kfifo_alloc(&sc->fifo, clamp(fifo_depth, 2U, 4096U), GFP_KERNEL);
   if (ret) {
-    pr_err("scd41: failed to create sysfs group\n");
+    dev_err(&client->dev, "failed to allocate sample buffer\n");
+    goto err_free_stats;
+  }
+
+  /*
+   * 이후로는 devm이 probe의 참조를 풂. 먼저 등록했으므로 IIO 장치/트리거(devm)가 해제된 다음에 실행되어
+   * 트리거 핸들러와 버퍼 콜백이 sc를 쓰는 동안에는 버퍼와 통계가 남아 있음 (실패하면 바로 해제)
+   */
+  ret = devm_add_action_or_reset(&client->dev, scd41_put_action, sc);
+  if (ret)
     return ret;
+
+  indio_dev = devm_iio_device_alloc(&client->dev, sizeof(sc));
+  if (!indio_dev)
+    return -ENOMEM;
+  *(struct scd41**)iio_priv(indio_dev) = sc;
+  sc->indio = indio_dev;
+
+  sc->id = ida_alloc_max(&scd41_ida, SCD41_MAX_DEVICES - 1, GFP_KERNEL);
+  if (sc->id < 0)
+    return sc->id;
+
+  ret = scd41_iio_init(sc);
+  if (ret) {
+    dev_err(&client->dev, "failed to register iio device\n");
+    goto err_ida;
   }
 
-  dev_set_drvdata(&client->dev, client);
+  ret = sysfs_create_group(&client->dev.kobj, &scd41_group);
+  if (ret) {
+    dev_err(&client->dev, "failed to create sysfs group\n");
+    goto err_ida;
+  }
+
+  mutex_lock(&scd41_table_lock);
+  scd41_table[sc->id] = sc;
+  mutex_unlock(&scd41_table_lock);
+
+  sc->cdev = cdev_alloc();
+  if (!sc->cdev) {
+    ret = -ENOMEM;
+    goto err_table;
+  }
+  sc->cdev->ops = &scd41_fops;
+  sc->cdev->owner = THIS_MODULE;
+  ret = cdev_add(sc->cdev, MKDEV(MAJOR(scd41_devt), sc->id), 1);
+  if (ret) {
+    kobject_put(&sc->cdev->kobj);
+    goto err_table;
+  }
+
+  sc->dev = device_create(scd41_class, &client->dev, MKDEV(MAJOR(scd41_devt), sc->id), sc, NODE_NAME, sc->id);
+  if (IS_ERR(sc->dev)) {
+    dev_err(&client->dev, "device_create failed\n");
+    ret = PTR_ERR(sc->dev);
+    goto err_cdev;
+  }
 
+  /* 스케줄러에 등록, enable 전까지는 아무것도 하지 않음 */
+  mutex_lock(&scd41_sensors_lock);
+  list_add_tail(&sc->node, &scd41_sensors);
+  mutex_unlock(&scd41_sensors_lock);
+
+  dev_info(&client->dev, "scd41-%d: probed at 0x%02x on %s\n", sc->id, client->addr, client->adapter->name);
   return 0;
+
+err_cdev:
+  cdev_del(sc->cdev);
+err_table:
+  mutex_lock(&scd41_table_lock);
+  scd41_table[sc->id] = NULL;
+  mutex_unlock(&scd41_table_lock);
+  sysfs_remove_group(&client->dev.kobj, &scd41_group);
+err_ida:
+  ida_free(&scd41_ida, sc->id);
+  return ret;
+
+err_free_stats:
+  kvfree(sc->stats);
+err_free:
+  kfree(sc);
+  return ret;
 }
 
+/*
+ * 새 open을 막고 스케줄러에서 뺀 뒤 removed 표시. 버퍼와 sc는 이 함수가 끝난 뒤
+ * devm이 IIO 장치를 해제하고, 열린 파일도 모두 닫혀야 scd41_free()에서 해제
+ */
 static void scd41_remove(struct i2c_client* client) {
-  if (scd41_thread) {
-    kthread_stop(scd41_thread);
-  }
+  struct scd41* sc = i2c_get_clientdata(client);
+  bool running;
+
+  mutex_lock(&scd41_table_lock);
+  scd41_table[sc->id] = NULL;
+  mutex_unlock(&scd41_table_lock);
+
+  device_destroy(scd41_class, MKDEV(MAJOR(scd41_devt), sc->id));
+  cdev_del(sc->cdev);
+
+  /* 스케줄러에서 빼고 (진행 중인 차례가 끝날 때까지 대기) 주기 측정 중이면 멈춤 */
+  mutex_lock(&scd41_sensors_lock);
+  list_del(&sc->node);
+  running = sc->running >= 0;
+  if (running)
+    sensirion_i2c_cmd(client, SCD41_CMD_STOP_PERIODIC);
+  mutex_unlock(&scd41_sensors_lock);
+  if (running)
+    msleep(SCD41_STOP_MS);
+
   sysfs_remove_group(&client->dev.kobj, &scd41_group);
-  pr_info("scd41: removed\n");
+
+  /* 이후 enable/mode 요청은 스케줄러 목록에 없으므로 I2C를 건드리지 않음 */
+  WRITE_ONCE(sc->removed, true);
+  wake_up_interruptible(&sc->fifo_wq); // 읽기 대기자는 -ENODEV
+
+  ida_free(&scd41_ida, sc->id);
+  dev_info(&client->dev, "scd41-%d: removed\n", sc->id);
 }
 
 /* DT 매칭 테이블 */
@@ -228,16 +1532,51 @@ static struct i2c_driver scd41_driver = {
     .id_table = scd41_id,
 };
 
-/* DT 기반일 땐 이 매크로 하나로 init/exit 처리 */
-module_i2c_driver(scd41_driver);
-/*
+/* 여러 센서가 major 번호, class, 스케줄러를 공유하므로 드라이버 등록 전에 한 번만 생성 */
 static int __init scd41_driver_init(void) {
-  return i2c_add_driver(&scd41_driver);
+  int ret;
+
+  ret = alloc_chrdev_region(&scd41_devt, 0, SCD41_MAX_DEVICES, SCD41_DRV_NAME);
+  if (ret < 0) {
+    pr_err("scd41: alloc_chrdev_region failed\n");
+    return ret;
+  }
+
+  scd41_class = class_create(CLASS_NAME);
+  if (IS_ERR(scd41_class)) {
+    ret = PTR_ERR(scd41_class);
+    goto err_region;
+  }
+  scd41_class->devnode = scd41_devnode;
+
+  scd41_sched = kthread_run(scd41_sched_fn, NULL, "scd41_sched");
+  if (IS_ERR(scd41_sched)) {
+    pr_err("scd41: failed to create scheduler thread\n");
+    ret = PTR_ERR(scd41_sched);
+    goto err_class;
+  }
+
+  ret = i2c_add_driver(&scd41_driver);
+  if (ret)
+    goto err_sched;
+
+  return 0;
+
+err_sched:
+  kthread_stop(scd41_sched);
+err_class:
+  class_destroy(scd41_class);
+err_region:
+  unregister_chrdev_region(scd41_devt, SCD41_MAX_DEVICES);
+  return ret;
 }
+
 static void __exit scd41_driver_exit(void) {
   i2c_del_driver(&scd41_driver);
+  kthread_stop(scd41_sched);
+  class_destroy(scd41_class);
+  unregister_chrdev_region(scd41_devt, SCD41_MAX_DEVICES);
 }
 
 module_init(scd41_driver_init);
 module_exit(scd41_driver_exit);
-*/
\ No newline at end of file
@@ -3,10 +3,17 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include "scd41.h"
 
 #define SYSFS_PATH_CO2  "/sys/bus/i2c/devices/1-0062/co2"
 #define SYSFS_PATH_TEMP "/sys/bus/i2c/devices/1-0062/temp"
 #define SYSFS_PATH_HUM  "/sys/bus/i2c/devices/1-0062/hum"
+#define SYSFS_PATH_TS   "/sys/bus/i2c/devices/1-0062/timestamp"
+#define SYSFS_PATH_BIN  "/sys/bus/i2c/devices/1-0062/measurement_bin"
+#define DEV_PATH        "/dev/scd41-0"
 
 int read_sysfs_value(const char* path, char* buf, size_t size) {
   int fd = open(path, O_RDONLY);
@@ -27,17 +34,150 @@ int read_sysfs_value(const char* path, char* buf, size_t size) {
   return 0;
 }
 
-int main() {
-  char co2[32], temp[32], hum[32];
+/* /dev/scd41-0에서 레코드를 한 번에 여러 개씩 받아 출력 (Ctrl+C로 종료) */
+int stream(void) {
+  struct scd41_sample samples[16];
+  int fd = open(DEV_PATH, O_RDONLY);
+  if (fd < 0) {
+    perror("open");
+    return -1;
+  }
+
+  while (1) {
+    ssize_t len = read(fd, samples, sizeof(samples)); // 새 레코드가 올 때까지 대기
+    if (len < 0) {
+      perror("read");
+      close(fd);
+      return -1;
+    }
+    for (int i = 0; i < len / (ssize_t)sizeof(samples[0]); ++i) {
+      struct scd41_sample* s = &samples[i];
+      printf("%llu.%03llu  CO2 %5d ppm  Temp %s%2d.%02d °C  Hum %3d.%02d %%%s%s\n",
+        s->timestamp_ns / 1000000000ULL, s->timestamp_ns / 1000000ULL % 1000, s->co2,
+        s->temp_centi < 0 ? "-" : " ", abs(s->temp_centi) / 100, abs(s->temp_centi) % 100,
+        s->hum_centi / 100, s->hum_centi % 100,
+        (s->status & SCD41_STATUS_FIRST) ? "  [first]" : "", (s->status & SCD41_STATUS_OVERRUN) ? "  [overrun]" : "");
+    }
+  }
+}
+
+void print_stat(const char* name, const struct scd41_stat* s, int centi) {
+  const int v[] = { s->min, s->max, s->mean, s->median, s->ema };
+  printf("    %-5s", name);
+  for (int i = 0; i < 5; ++i) {
+    if (centi)
+      printf(" %s%4d.%02d", v[i] < 0 ? "-" : " ", abs(v[i]) / 100, abs(v[i]) % 100);
+    else
+      printf(" %8d", v[i]);
+  }
+  printf("\n");
+}
+
+/* measurement_bin 한 번 읽어 마지막 측정과 이동 통계 출력 */
+int stats(void) {
+  struct scd41_measurement m;
+  int fd = open(SYSFS_PATH_BIN, O_RDONLY);
+  if (fd < 0) {
+    perror("open");
+    return -1;
+  }
+  if (pread(fd, &m, sizeof(m), 0) != sizeof(m)) {
+    perror("pread");
+    close(fd);
+    return -1;
+  }
+  close(fd);
+
+  printf("  seq %llu  CO2 %d ppm  Temp %s%d.%02d °C  Hum %d.%02d %%\n", m.seq, m.co2,
+    m.temp_centi < 0 ? "-" : "", abs(m.temp_centi) / 100, abs(m.temp_centi) % 100,
+    m.hum_centi / 100, m.hum_centi % 100);
+  for (int i = 0; i < SCD41_STATS_WINDOWS; ++i) {
+    const struct scd41_window_stats* w = &m.stats[i];
+    if (!w->window_s) continue;
+    printf("  %u s window, %u samples over %u s%s       min      max     mean   median      ema\n", w->window_s,
+      w->count, w->span_s, (w->flags & SCD41_STATS_TRUNCATED) ? " (truncated)" : "");
+    if (!w->count) continue;
+    print_stat("co2", &w->co2, 0);
+    print_stat("temp", &w->temp, 1);
+    print_stat("hum", &w->hum, 1);
+  }
+  return 0;
+}
+
+/* 단발 모드로 바꾸고 측정 하나를 요청, 결과 레코드가 올 때까지 걸린 시간 출력 (enable = 1, root 필요) */
+int shot(int rht) {
+  int mode = rht ? SCD41_MODE_SINGLE_SHOT_RHT : SCD41_MODE_SINGLE_SHOT;
+  struct scd41_sample s;
+  struct pollfd pfd;
+  struct timespec t0, t1;
+  int fd = open(DEV_PATH, O_RDWR | O_NONBLOCK); // SET_MODE / MEASURE는 쓰기로 연 파일만
+  if (fd < 0) {
+    perror("open");
+    return -1;
+  }
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+
+  if (ioctl(fd, SCD41_IOCTL_SET_MODE, &mode) < 0) {
+    perror("SCD41_IOCTL_SET_MODE");
+    close(fd);
+    return -1;
+  }
+  while (read(fd, &s, sizeof(s)) == sizeof(s)); // 이전 레코드 비우기
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  if (ioctl(fd, SCD41_IOCTL_MEASURE) < 0) {
+    perror("SCD41_IOCTL_MEASURE (enable = 1?)");
+    close(fd);
+    return -1;
+  }
+  if (poll(&pfd, 1, 10000) <= 0 || read(fd, &s, sizeof(s)) != sizeof(s)) {
+    printf("no sample\n");
+    close(fd);
+    return -1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  printf("%.3f s  CO2 %5d ppm  Temp %s%2d.%02d °C  Hum %3d.%02d %%%s\n",
+    (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9, s.co2,
+    s.temp_centi < 0 ? "-" : " ", abs(s.temp_centi) / 100, abs(s.temp_centi) % 100,
+    s.hum_centi / 100, s.hum_centi % 100,
+    (s.status & SCD41_STATUS_RHT_ONLY) ? "  [rht only]" : "");
+  close(fd);
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  char co2[32], temp[32], hum[32], ts[32];
+  struct timespec now;
+
+  /*
+   * ./test : sysfs 값 한 번 출력, ./test stream : /dev/scd41-0 레코드 연속 출력
+   * ./test shot [rht] : 단발 측정 하나, ./test stats : 이동 통계
+   */
+  if (argc > 1 && !strcmp(argv[1], "stream")) {
+    return stream() < 0 ? 1 : 0;
+  }
+  if (argc > 1 && !strcmp(argv[1], "stats")) {
+    return stats() < 0 ? 1 : 0;
+  }
+  if (argc > 1 && !strcmp(argv[1], "shot")) {
+    return shot(argc > 2 && !strcmp(argv[2], "rht")) < 0 ? 1 : 0;
+  }
 
   if (read_sysfs_value(SYSFS_PATH_CO2, co2, sizeof(co2)) < 0) return 1;
   if (read_sysfs_value(SYSFS_PATH_TEMP, temp, sizeof(temp)) < 0) return 1;
   if (read_sysfs_value(SYSFS_PATH_HUM, hum, sizeof(hum)) < 0) return 1;
+  if (read_sysfs_value(SYSFS_PATH_TS, ts, sizeof(ts)) < 0) return 1;
+  clock_gettime(CLOCK_REALTIME, &now);
 
   printf("  SCD41 Sensor Data\n");
   printf("  CO2   : %s ppm\n", co2);
   printf("  Temp  : %s °C\n", temp);
   printf("  Hum   : %s %%\n", hum);
+  if (strtoull(ts, NULL, 10) != 0) {
+    printf("  Age   : %.3f s\n", (now.tv_sec * 1e9 + now.tv_nsec - strtoull(ts, NULL, 10)) / 1e9);
+  }
 
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#ifndef __SENSIRION_I2C_H_
+#define __SENSIRION_I2C_H_
+
+/*
+ * Sensirion I2C word 프로토콜 (SCD4x, SHT4x, SGP41, SCD30 공통).
+ *   명령: 16비트 big endian
+ *   word: 16비트 big endian + CRC8 (poly 0x31, init 0xFF), 읽기/쓰기 모두 word마다 CRC
+ * 헤더만으로 쓰는 라이브러리: 드라이버는 #include "../sensirion/sensirion_i2c.h"로 가져다 씀.
+ * 인코딩/디코딩과 CRC는 유저 공간에서도 컴파일됨 (sensirion/test.c)
+ */
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/i2c.h>
+#include <linux/delay.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+typedef uint8_t u8;
+typedef uint16_t u16;
+#endif
+
+#define SENSIRION_CRC8_POLY  0x31
+#define SENSIRION_CRC8_INIT  0xFF
+#define SENSIRION_WORD_SIZE  3     /* 2바이트 + CRC */
+#define SENSIRION_MAX_WORDS  9     /* SCD30 측정 6 word, 시리얼 번호 3 word 등 */
+#define SENSIRION_BUF_SIZE   (2 + SENSIRION_MAX_WORDS * SENSIRION_WORD_SIZE)
+
+/* 명령 실행 시간 대기: usleep_range(exec, exec + SLACK) */
+#define SENSIRION_EXEC_SLACK_US  200
+
+/*
+ * CRC 테이블을 컴파일 타임에 생성. CRC8은 입력 바이트에 대해 선형이므로
+ * table[b] = b의 켜진 비트 i마다 table[1 << i]를 XOR한 값.
+ * table[1] = poly, table[1 << (i+1)] = table[1 << i]를 한 비트 시프트한 값
+ */
+#define SENSIRION_CRC_STEP(c)  ((((c) << 1) ^ (((c) & 0x80) ? SENSIRION_CRC8_POLY : 0)) & 0xFF)
+
+enum {
+  SENSIRION_CRC_B0 = SENSIRION_CRC8_POLY,
+  SENSIRION_CRC_B1 = SENSIRION_CRC_STEP(SENSIRION_CRC_B0),
+  SENSIRION_CRC_B2 = SENSIRION_CRC_STEP(SENSIRION_CRC_B1),
+  SENSIRION_CRC_B3 = SENSIRION_CRC_STEP(SENSIRION_CRC_B2),
+  SENSIRION_CRC_B4 = SENSIRION_CRC_STEP(SENSIRION_CRC_B3),
+  SENSIRION_CRC_B5 = SENSIRION_CRC_STEP(SENSIRION_CRC_B4),
+  SENSIRION_CRC_B6 = SENSIRION_CRC_STEP(SENSIRION_CRC_B5),
+  SENSIRION_CRC_B7 = SENSIRION_CRC_STEP(SENSIRION_CRC_B6),
+};
+
+#define SENSIRION_CRC_T(b) \
+  ((((b) & 0x01) ? SENSIRION_CRC_B0 : 0) ^ (((b) & 0x02) ? SENSIRION_CRC_B1 : 0) ^ \
+   (((b) & 0x04) ? SENSIRION_CRC_B2 : 0) ^ (((b) & 0x08) ? SENSIRION_CRC_B3 : 0) ^ \
+   (((b) & 0x10) ? SENSIRION_CRC_B4 : 0) ^ (((b) & 0x20) ? SENSIRION_CRC_B5 : 0) ^ \
+   (((b) & 0x40) ? SENSIRION_CRC_B6 : 0) ^ (((b) & 0x80) ? SENSIRION_CRC_B7 : 0))
+#define SENSIRION_CRC_T4(b)   SENSIRION_CRC_T(b), SENSIRION_CRC_T((b) + 1), SENSIRION_CRC_T((b) + 2), SENSIRION_CRC_T((b) + 3)
+#define SENSIRION_CRC_T16(b)  SENSIRION_CRC_T4(b), SENSIRION_CRC_T4((b) + 4), SENSIRION_CRC_T4((b) + 8), SENSIRION_CRC_T4((b) + 12)
+#define SENSIRION_CRC_T64(b)  SENSIRION_CRC_T16(b), SENSIRION_CRC_T16((b) + 16), SENSIRION_CRC_T16((b) + 32), SENSIRION_CRC_T16((b) + 48)
+
+static const u8 sensirion_crc8_table[256] = {
+  SENSIRION_CRC_T64(0), SENSIRION_CRC_T64(64), SENSIRION_CRC_T64(128), SENSIRION_CRC_T64(192),
+};
+
+static inline u8 sensirion_crc8(const u8* data, size_t len) {
+  u8 crc = SENSIRION_CRC8_INIT;
+
+  while (len--)
+    crc = sensirion_crc8_table[crc ^ *data++];
+  return crc;
+}
+
+/* === 인코딩/디코딩 (I2C 없이) === */
+
+/* 명령 2바이트, 반환값 = 바이트 수 */
+static inline int sensirion_encode_cmd(u8* buf, u16 cmd) {
+  buf[0] = cmd >> 8;
+  buf[1] = cmd & 0xFF;
+  return 2;
+}
+
+/* 명령 + 인자 n개 (word마다 CRC 생성), 반환값 = 바이트 수 */
+static inline int sensirion_encode_words(u8* buf, u16 cmd, const u16* args, int n) {
+  int len = sensirion_encode_cmd(buf, cmd);
+  int i;
+
+  for (i = 0; i < n; i++) {
+    buf[len] = args[i] >> 8;
+    buf[len + 1] = args[i] & 0xFF;
+    buf[len + 2] = sensirion_crc8(buf + len, 2);
+    len += SENSIRION_WORD_SIZE;
+  }
+  return len;
+}
+
+/* 받은 n word를 CRC 확인 후 꺼냄, CRC가 하나라도 틀리면 -EIO */
+static inline int sensirion_decode_words(const u8* buf, u16* words, int n) {
+  int i;
+
+  for (i = 0; i < n; i++) {
+    const u8* w = buf + i * SENSIRION_WORD_SIZE;
+
+    if (sensirion_crc8(w, 2) != w[2])
+      return -EIO;
+    words[i] = (w[0] << 8) | w[1];
+  }
+  return 0;
+}
+
+#ifdef __KERNEL__
+/* === I2C === */
+
+static inline int sensirion_i2c_send(struct i2c_client* client, const u8* buf, int len) {
+  int ret;
+
+  ret = i2c_master_send(client, buf, len);
+  if (ret < 0) return ret;
+  return ret == len ? 0 : -EIO;
+}
+
+static inline int sensirion_i2c_cmd(struct i2c_client* client, u16 cmd) {
+  u8 buf[2];
+
+  return sensirion_i2c_send(client, buf, sensirion_encode_cmd(buf, cmd));
+}
+
+/* 명령 + 인자 쓰기 (set_temperature_offset 등) */
+static inline int sensirion_i2c_write_words(struct i2c_client* client, u16 cmd, const u16* args, int n) {
+  u8 buf[SENSIRION_BUF_SIZE];
+
+  if (n < 0 || n > SENSIRION_MAX_WORDS)
+    return -EINVAL;
+  return sensirion_i2c_send(client, buf, sensirion_encode_words(buf, cmd, args, n));
+}
+
+/*
+ * 명령 쓰기 → exec_us 대기 → 응답 읽기. 센서는 명령을 실행하는 동안 읽기에 NACK하므로
+ * repeated start 한 번의 i2c_transfer로는 묶을 수 없음. 버스는 쓰기/읽기 메시지 동안만 잠기고
+ * 기다리는 동안에는 같은 버스의 다른 장치(LCD 버스트 등)가 쓸 수 있음 (센서는 그 사이 트래픽과 무관)
+ */
+static inline int sensirion_i2c_exec(struct i2c_client* client, const u8* tx, int txlen, u8* rx, int rxlen,
+  unsigned int exec_us) {
+  struct i2c_msg wr = {
+    .addr = client->addr, .flags = client->flags & I2C_M_TEN, .len = txlen, .buf = (u8*)tx,
+  };
+  struct i2c_msg rd = {
+    .addr = client->addr, .flags = (client->flags & I2C_M_TEN) | I2C_M_RD, .len = rxlen, .buf = rx,
+  };
+  int ret;
+
+  ret = i2c_transfer(client->adapter, &wr, 1);
+  if (ret == 1) {
+    usleep_range(exec_us, exec_us + SENSIRION_EXEC_SLACK_US);
+    ret = i2c_transfer(client->adapter, &rd, 1);
+  }
+
+  if (ret < 0) return ret;
+  return ret == 1 ? 0 : -EIO;
+}
+
+/* 명령 전송 후 exec_us(데이터시트 실행 시간) 뒤 n word를 읽어 CRC 확인 */
+static inline int sensirion_i2c_read_words(struct i2c_client* client, u16 cmd, u16* words, int n,
+  unsigned int exec_us) {
+  u8 cmd_buf[2];
+  u8 buf[SENSIRION_BUF_SIZE];
+  int ret;
+
+  if (n <= 0 || n > SENSIRION_MAX_WORDS)
+    return -EINVAL;
+
+  ret = sensirion_i2c_exec(client, cmd_buf, sensirion_encode_cmd(cmd_buf, cmd), buf, n * SENSIRION_WORD_SIZE,
+    exec_us);
+  if (ret < 0) return ret;
+
+  return sensirion_decode_words(buf, words, n);
+}
+#endif
+
+#endif
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sensirion_i2c.h"
+
+/*
+ * sensirion_i2c.h 유저 공간 단위 테스트 + CRC 마이크로벤치마크
+ *   gcc -O2 -o test test.c && ./test [MB]
+ */
+
+static int failed;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      failed++; \
+    } \
+  } while (0)
+
+/* 비교용: 드라이버가 쓰던 비트 단위 CRC */
+static u8 crc8_bitwise(const u8* data, size_t len) {
+  u8 crc = 0xFF;
+  size_t i, j;
+  for (j = 0; j < len; j++) {
+    crc ^= data[j];
+    for (i = 0; i < 8; i++) {
+      if (crc & 0x80)
+        crc = (crc << 1) ^ 0x31;
+      else
+        crc <<= 1;
+    }
+  }
+  return crc;
+}
+
+static void test_crc(void) {
+  const u8 beef[2] = { 0xBE, 0xEF };
+  u8 buf[64];
+  int b, i;
+
+  /* 데이터시트 CRC 예제 */
+  CHECK(sensirion_crc8(beef, 2) == 0x92);
+
+  /* 테이블 = 비트 단위 (바이트 하나, 임의 길이) */
+  for (b = 0; b < 256; b++) {
+    u8 c = b;
+    CHECK(sensirion_crc8(&c, 1) == crc8_bitwise(&c, 1));
+  }
+  srand(1);
+  for (i = 0; i < 1000; i++) {
+    size_t len = rand() % sizeof(buf);
+    for (b = 0; b < (int)len; b++)
+      buf[b] = rand();
+    CHECK(sensirion_crc8(buf, len) == crc8_bitwise(buf, len));
+  }
+  CHECK(sensirion_crc8(buf, 0) == SENSIRION_CRC8_INIT);
+}
+
+static void test_codec(void) {
+  const u16 args[2] = { 0x07E6, 0xBEEF };
+  u8 buf[SENSIRION_BUF_SIZE];
+  u16 words[2];
+  int len;
+
+  /* 명령만 */
+  CHECK(sensirion_encode_cmd(buf, 0x21B1) == 2);
+  CHECK(buf[0] == 0x21 && buf[1] == 0xB1);
+
+  /* set_temperature_offset(5.4 °C): 0x241D 0x07E6 0x48 */
+  len = sensirion_encode_words(buf, 0x241D, args, 2);
+  CHECK(len == 8);
+  CHECK(buf[0] == 0x24 && buf[1] == 0x1D);
+  CHECK(buf[2] == 0x07 && buf[3] == 0xE6 && buf[4] == 0x48);
+  CHECK(buf[5] == 0xBE && buf[6] == 0xEF && buf[7] == 0x92);
+
+  /* 인코딩한 word를 그대로 디코딩 */
+  memset(words, 0, sizeof(words));
+  CHECK(sensirion_decode_words(buf + 2, words, 2) == 0);
+  CHECK(words[0] == 0x07E6 && words[1] == 0xBEEF);
+
+  /* 데이터나 CRC가 한 비트라도 틀리면 -EIO */
+  buf[6] ^= 0x01;
+  CHECK(sensirion_decode_words(buf + 2, words, 2) == -EIO);
+  buf[6] ^= 0x01;
+  buf[4] ^= 0x80;
+  CHECK(sensirion_decode_words(buf + 2, words, 2) == -EIO);
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* size바이트를 word 단위(2바이트)로 CRC 계산, 실제 사용 패턴과 같게 */
+static void bench(size_t size) {
+  u8* data = malloc(size);
+  volatile u8 sink = 0;
+  double t0, t_bit, t_table;
+  size_t i;
+
+  if (!data) {
+    perror("malloc");
+    return;
+  }
+  for (i = 0; i < size; i++)
+    data[i] = rand();
+
+  t0 = now_sec();
+  for (i = 0; i + 2 <= size; i += 2)
+    sink ^= crc8_bitwise(data + i, 2);
+  t_bit = now_sec() - t0;
+
+  t0 = now_sec();
+  for (i = 0; i + 2 <= size; i += 2)
+    sink ^= sensirion_crc8(data + i, 2);
+  t_table = now_sec() - t0;
+
+  printf("CRC8 over %zu MB (2-byte words)\n", size >> 20);
+  printf("  bitwise : %8.1f MB/s  %6.2f ns/word\n", size / t_bit / 1e6, t_bit * 1e9 / (size / 2));
+  printf("  table   : %8.1f MB/s  %6.2f ns/word  (x%.1f)\n", size / t_table / 1e6, t_table * 1e9 / (size / 2),
+    t_bit / t_table);
+  (void)sink;
+  free(data);
+}
+
+int main(int argc, char* argv[]) {
+  size_t mb = argc > 1 ? strtoul(argv[1], NULL, 0) : 64;
+
+  test_crc();
+  test_codec();
+  if (failed) {
+    printf("%d check(s) failed\n", failed);
+    return 1;
+  }
+  printf("all checks passed\n");
+
+  if (mb)
+    bench(mb << 20);
+  return 0;
+}